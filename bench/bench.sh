@@ -0,0 +1,118 @@
+#!/bin/sh
+# bench: throughput benchmark for xvp
+#
+# Generates synthetic argument lists and runs xvp (and "xargs -0" as
+# baseline) against no-op sink (bench/sink) and /bin/true.
+# Runner "xvp-plan" runs "xvp --plan" which reads and batches arguments
+# but runs nothing - i.e. it's xvp's own throughput.
+#
+# Environment:
+#   BENCH_DISTS     - list of "<name>:<min length>:<max length>"
+#   BENCH_COUNTS    - list of argument counts
+#   BENCH_MAX_BYTES - skip argument lists larger than this (estimated)
+#   BENCH_RUNNERS   - list of runners: xvp-plan xvp-sink xvp-true xargs-sink xargs-true
+#   BENCH_XVP       - xvp binary to benchmark
+#   BENCH_TMPDIR    - directory for temporary files
+#
+# Output (tab-separated, one line per run):
+#   dist count bytes runner rc batches gen_s wall_s user_s sys_s maxrss_kb args_per_s bytes_per_s read_s tokenize_s spawn_s wait_s
+#
+# Per-phase timings (read_s ... wait_s) are taken from "xvp --stats" and
+# are available only for xvp runners.
+#
+# Nota bene: "xargs" uses its own (lower) default limit for command line length,
+# so it's expected to run more batches (and fail on huge arguments).
+#
+# SPDX-License-Identifier: Apache-2.0
+# (c) 2022-2023, Konstantin Demin
+
+set -ef
+
+: "${BENCH_DISTS:=tiny:1:16 path:16:256 large:1024:32768 huge:65536:131070}"
+: "${BENCH_COUNTS:=10 1000 100000 10000000}"
+: "${BENCH_MAX_BYTES:=268435456}"
+: "${BENCH_RUNNERS:=xvp-plan xvp-sink xvp-true xargs-sink xargs-true}"
+: "${BENCH_XVP:=./xvp}"
+
+dir0=$(dirname "$0")
+genargs="${dir0}/genargs"
+sink="${dir0}/sink"
+timeit="${dir0}/timeit"
+
+for f in "${BENCH_XVP}" "${genargs}" "${sink}" "${timeit}" ; do
+	[ -x "$f" ] && continue
+	echo "bench: $f is missing (run 'make bench')" >&2
+	exit 1
+done
+
+tmp=$(mktemp -d "${BENCH_TMPDIR:-${TMPDIR:-/tmp}}/xvp-bench.XXXXXXXX")
+trap 'rm -rf "${tmp}"' EXIT INT TERM
+
+args="${tmp}/args"
+batches="${tmp}/batches"
+times="${tmp}/times"
+stats="${tmp}/stats"
+
+# extract per-phase timings (in seconds) from "xvp --stats" output
+phase_times() {
+	[ -s "${stats}" ] || { printf -- '-\t-\t-\t-\n' ; return ; }
+	sed -E 's/.*"time_ns":\{([^}]*)\}.*/\1/' "${stats}" \
+	| awk -F '[:,]' '{
+		for (i = 1; i < NF; i += 2) { k = $i; gsub(/"/, "", k); t[k] = $(i + 1) / 1e9 }
+		printf "%.6f\t%.6f\t%.6f\t%.6f\n", t["read"], t["tokenize"], t["spawn"], t["wait"]
+	}'
+}
+
+printf '%s\t' dist count bytes runner rc batches gen_s wall_s user_s sys_s maxrss_kb args_per_s
+printf '%s\t' bytes_per_s read_s tokenize_s spawn_s
+printf '%s\n' wait_s
+
+for d in ${BENCH_DISTS} ; do
+	d_name=${d%%:*} ; d=${d#*:}
+	d_min=${d%%:*}  ; d_max=${d#*:}
+
+	for n in ${BENCH_COUNTS} ; do
+		est=$(( n * (d_min + d_max + 2) / 2 ))
+		if [ "${est}" -gt "${BENCH_MAX_BYTES}" ] ; then
+			echo "bench: skipping ${d_name} x ${n}: ~${est} bytes is over BENCH_MAX_BYTES" >&2
+			continue
+		fi
+
+		"${timeit}" "${genargs}" "${args}" "$n" "${d_min}" "${d_max}" > "${times}"
+		read -r gen_s _ < "${times}"
+		bytes=$(wc -c < "${args}")
+
+		for r in ${BENCH_RUNNERS} ; do
+			case "$r" in
+			xvp-plan)   set -- "${BENCH_XVP}" --stats=4 --plan "${sink}" "${args}" ;;
+			xvp-sink)   set -- "${BENCH_XVP}" --stats=4 "${sink}" "${args}" ;;
+			xvp-true)   set -- "${BENCH_XVP}" --stats=4 /bin/true "${args}" ;;
+			xargs-sink) set -- xargs -0 -r -a "${args}" "${sink}" ;;
+			xargs-true) set -- xargs -0 -r -a "${args}" /bin/true ;;
+			*)
+				echo "bench: unknown runner: $r" >&2
+				exit 1
+			;;
+			esac
+
+			: > "${batches}"
+			: > "${stats}"
+			rc=0
+			"${timeit}" "$@" > "${times}" 3>> "${batches}" 4> "${stats}" || rc=$?
+			read -r wall_s user_s sys_s maxrss_kb < "${times}"
+
+			b=-
+			case "$r" in
+			*-sink)   b=$(wc -l < "${batches}") ;;
+			xvp-plan) b=$(sed -nE 's/.*"spawned":([0-9]+).*/\1/p' "${stats}") ;;
+			esac
+
+			printf '%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t' \
+				"${d_name}" "$n" "${bytes}" "$r" "${rc}" "$b" "${gen_s}" \
+				"${wall_s}" "${user_s}" "${sys_s}" "${maxrss_kb}"
+			awk -v n="$n" -v b="${bytes}" -v t="${wall_s}" \
+				'BEGIN { if (t <= 0) t = 1e-6; printf "%.0f\t%.0f\t", n / t, b / t }'
+			phase_times
+		done
+	done
+done
@@ -0,0 +1,104 @@
+/* genargs: generate synthetic NUL-separated argument list
+ *
+ * Usage: genargs <output file> <count> <min length> <max length> [<seed>]
+ *
+ * Specify "-" as <output file> to write to stdout.
+ * Argument lengths are uniformly distributed in [min length, max length].
+ * Output is deterministic for given set of parameters.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GENARGS_LENGTH_MAX  (32 * 4096)
+#define GENARGS_BUFFER      (GENARGS_LENGTH_MAX * 4)
+
+static uint64_t prng_state;
+
+// ref: https://en.wikipedia.org/wiki/Xorshift#xorshift*
+static uint64_t prng(void)
+{
+	prng_state ^= prng_state >> 12;
+	prng_state ^= prng_state << 25;
+	prng_state ^= prng_state >> 27;
+	return prng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static char pattern[GENARGS_LENGTH_MAX * 2];
+static char out[GENARGS_BUFFER];
+static size_t n_out;
+static int fd_out = STDOUT_FILENO;
+
+static int flush_out(void)
+{
+	size_t x = 0;
+	while (x < n_out) {
+		ssize_t r = write(fd_out, out + x, n_out - x);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			return 0;
+		}
+		x += r;
+	}
+	n_out = 0;
+	return 1;
+}
+
+int main(int argc, char * argv[])
+{
+	if ((argc < 5) || (argc > 6)) {
+		fputs("Usage: genargs <output file> <count> <min length> <max length> [<seed>]\n", stderr);
+		return EINVAL;
+	}
+
+	unsigned long long count = strtoull(argv[2], NULL, 10);
+	unsigned long len_min = strtoul(argv[3], NULL, 10);
+	unsigned long len_max = strtoul(argv[4], NULL, 10);
+	prng_state = (argc > 5) ? strtoull(argv[5], NULL, 10) : 0;
+	if (!prng_state) prng_state = 0x9E3779B97F4A7C15ULL;
+
+	if ((!len_min) || (len_min > len_max) || (len_max >= GENARGS_LENGTH_MAX)) {
+		fprintf(stderr, "genargs: length range must be within [1, %d)\n", GENARGS_LENGTH_MAX);
+		return EINVAL;
+	}
+
+	if (strcmp(argv[1], "-") != 0) {
+		fd_out = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd_out < 0) {
+			perror("genargs: open(2)");
+			return errno;
+		}
+	}
+
+	// path-like content: lowercase letters and slashes
+	for (size_t i = 0; i < sizeof(pattern); i++) {
+		uint64_t r = prng() % 28;
+		pattern[i] = (r < 26) ? ('a' + r) : '/';
+	}
+
+	uint64_t span = len_max - len_min + 1;
+	for (unsigned long long i = 0; i < count; i++) {
+		size_t len = len_min + (prng() % span);
+		size_t off = prng() % (sizeof(pattern) - len);
+
+		if ((n_out + len + 1) > sizeof(out)) {
+			if (!flush_out()) return errno;
+		}
+
+		memcpy(out + n_out, pattern + off, len);
+		n_out += len;
+		out[n_out++] = 0;
+	}
+
+	if (!flush_out()) return errno;
+
+	return (close(fd_out) == 0) ? 0 : errno;
+}
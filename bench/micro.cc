@@ -0,0 +1,986 @@
+/* micro: microbenchmarks for uvector, memfun and num/ primitives
+ *
+ * Usage: micro [<case name prefix>]
+ *
+ * Output (tab-separated, one line per case and parameter):
+ *   case param ops ns_per_op grows
+ * where:
+ *   ops       - operations per round
+ *   ns_per_op - best (minimal) time per operation over all rounds
+ *   grows     - number of (re)allocations per round (or "-" if not applicable)
+ *
+ * Every case checks its results (counts and contents) in warm-up round (so checks don't affect
+ * timings); cases "ring_mt_*" check that every item passed between threads arrives exactly once
+ * in every round. On mismatch error is printed to stderr and micro exits with non-zero code.
+ *
+ * If built with MEMFUN_STATS=1 then memfun statistics of single round are appended:
+ *   allocs moved copied zeroed
+ * (allocations, moved reallocations, bytes copied and bytes zeroed).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <rockdrilla/misc/arena.hh>
+#include <rockdrilla/misc/monotime.h>
+#include <rockdrilla/num/degree2.h>
+#include <rockdrilla/num/getmsb.h>
+#include <rockdrilla/num/popcnt.h>
+#include <rockdrilla/uvector/uvector.hh>
+
+#define MICRO_ROUNDS      7
+#define MICRO_ROUND_NSEC  (20 * MONOTIME_NSEC_PER_MSEC)
+
+// approximate size of argument list in single batch
+#define MICRO_BATCH_BYTES  (2 * 1024 * 1024)
+
+#define MICRO_VALUES  4096
+
+static volatile size_t micro_sink;
+
+static const char * micro_filter = nullptr;
+
+// current case and whether its results should be checked (warm-up round)
+static const char * micro_case = nullptr;
+static int micro_check = 0;
+
+struct micro_result {
+	size_t ops;
+	size_t grows;
+};
+
+typedef micro_result (*micro_fn)(size_t param);
+
+static char str_source[8192];
+static unsigned long values[MICRO_VALUES];
+
+static void micro_run(const char * name, size_t param, micro_fn fn, int have_grows)
+{
+	if (micro_filter && (strncmp(name, micro_filter, strlen(micro_filter)) != 0))
+		return;
+
+	micro_result r = {};
+	uint64_t best = UINT64_MAX;
+
+	// warm up (and check results)
+	micro_case = name;
+	micro_check = 1;
+	(void) fn(param);
+	micro_check = 0;
+
+	for (int i = 0; i < MICRO_ROUNDS; i++) {
+		uint64_t reps = 0, start = monotime_ns(), t;
+		do {
+			r = fn(param);
+			reps++;
+			t = monotime_ns() - start;
+		} while (t < MICRO_ROUND_NSEC);
+
+		t /= reps;
+		if (t < best) best = t;
+	}
+
+	double ns = (r.ops) ? ((double) best / (double) r.ops) : (double) best;
+
+	if (have_grows)
+		printf("%s\t%zu\t%zu\t%.3f\t%zu", name, param, r.ops, ns, r.grows);
+	else
+		printf("%s\t%zu\t%zu\t%.3f\t-", name, param, r.ops, ns);
+
+	if (MEMFUN_STATS) {
+		memfun_stats_t m;
+		memfun_stats_reset();
+		(void) fn(param);
+		memfun_stats_get(&m);
+		printf("\t%zu\t%zu\t%zu\t%zu", m.allocs, m.reallocs_moved, m.bytes_copied, m.bytes_zeroed);
+	}
+
+	printf("\n");
+}
+
+static void micro_fail(const char * what, size_t value)
+{
+	fprintf(stderr, "micro: %s: %s: %zu\n", micro_case, what, value);
+	exit(1);
+}
+
+// allocator which counts successful (re)allocations ("grows" column)
+static size_t micro_grows;
+
+template<typename allocator_t = memfun_allocator>
+struct micro_allocator {
+
+	static CC_INLINE
+	void * alloc_ex(size_t * length) {
+		void * ptr = allocator_t::alloc_ex(length);
+		if (ptr) micro_grows++;
+		return ptr;
+	}
+
+	static CC_INLINE
+	void * realloc_policy(void * ptr, size_t * length, size_t extend, unsigned int policy) {
+		size_t old = *length;
+		void * nptr = allocator_t::realloc_policy(ptr, length, extend, policy);
+		if (*length != old) micro_grows++;
+		return nptr;
+	}
+
+	static CC_INLINE
+	void free(void * ptr, size_t length) {
+		allocator_t::free(ptr, length);
+	}
+
+};
+
+// strings of "length" bytes (from str_source): fill container and check round-trip
+template<typename str_t>
+static micro_result m_str_fill(size_t count, size_t length)
+{
+	micro_result r = { count, 0 };
+	str_t s;
+
+	micro_grows = 0;
+	for (size_t i = 0; i < count; i++)
+		(void) s.append(str_source + (i % 64), length);
+	r.grows = micro_grows;
+
+	if (micro_check) {
+		if (s.count() != count) micro_fail("strings stored", s.count());
+		for (size_t i = 0; i < count; i++) {
+			uvector::str_view v = s.get_view(i);
+			if ((v.length != length) || memcmp(v.ptr, str_source + (i % 64), length) || v.ptr[length])
+				micro_fail("string differs", i);
+		}
+	}
+
+	micro_sink += s.used();
+	s.free();
+	return r;
+}
+
+static micro_result m_str_append(size_t length)
+{
+	return m_str_fill<uvector::str<unsigned int, MEMFUN_GROWTH_DEFAULT, micro_allocator<>>>(MICRO_BATCH_BYTES / (length + 1), length);
+}
+
+// byte-packed strings: less memory per string, length without strlen(3)
+static micro_result m_str_compact(size_t length)
+{
+	return m_str_fill<uvector::str_compact<unsigned int, MEMFUN_GROWTH_DEFAULT, micro_allocator<>>>(MICRO_BATCH_BYTES / (length + 1), length);
+}
+
+// batch-like usage: fill container, then release all memory at once
+static arena micro_arena;
+
+static micro_result m_str_arena(size_t length)
+{
+	micro_result r = m_str_fill<uvector::str<unsigned int, MEMFUN_GROWTH_DEFAULT, micro_allocator<arena_allocator<&micro_arena>>>>(MICRO_BATCH_BYTES / (length + 1), length);
+	arena_reset(&micro_arena);
+	return r;
+}
+
+// growth policies: time per append should stay flat with growing size
+// for geometric policy (amortized O(1)) and grow with size for others
+
+#define MICRO_POLICY_ARG  32
+
+template<unsigned int policy>
+static micro_result m_str_policy(size_t size)
+{
+	return m_str_fill<uvector::str<unsigned int, policy, micro_allocator<>>>(size / MICRO_POLICY_ARG, MICRO_POLICY_ARG - 1);
+}
+
+// values 0 .. count-1: fill container and check them
+template<typename T>
+static micro_result m_dynmem_fill(size_t count)
+{
+	micro_result r = { count, 0 };
+	T d;
+
+	micro_grows = 0;
+	for (size_t i = 0; i < count; i++)
+		(void) d.append(i);
+	r.grows = micro_grows;
+
+	if (micro_check) {
+		if (d.count() != count) micro_fail("values stored", d.count());
+		for (size_t i = 0; i < count; i++) {
+			if (d.get_val(i) != i) micro_fail("value differs", i);
+		}
+	}
+
+	micro_sink += d.count();
+	d.free();
+	return r;
+}
+
+static micro_result m_dynmem_append(size_t count)
+{
+	return m_dynmem_fill<uvector::dynmem<size_t, size_t, 0, MEMFUN_GROWTH_DEFAULT, micro_allocator<>>>(count);
+}
+
+template<unsigned int policy>
+static micro_result m_dynmem_policy(size_t count)
+{
+	return m_dynmem_fill<uvector::dynmem<size_t, size_t, 0, policy, micro_allocator<>>>(count);
+}
+
+// small containers: in-place storage vs. dynamic memory
+template<typename T>
+static micro_result m_small_append(size_t count)
+{
+	return m_dynmem_fill<T>(count);
+}
+
+// access to protected members: "consume" element without writing it
+struct dynmem_probe : uvector::dynmem<size_t, size_t, 0, MEMFUN_GROWTH_DEFAULT, micro_allocator<>> {
+	void bump(void) { _used++; }
+};
+
+static micro_result m_dynmem_grow_auto(size_t count)
+{
+	micro_result r = {};
+	dynmem_probe d;
+
+	micro_grows = 0;
+	r.ops = count;
+	for (size_t i = 0; i < count; i++) {
+		if (!d.grow_auto()) break;
+		d.bump();
+	}
+	r.grows = micro_grows;
+
+	if (micro_check) {
+		if (d.used() != count) micro_fail("values consumed", d.used());
+		if (d.allocated() < count) micro_fail("values allocated", d.allocated());
+	}
+
+	micro_sink += d.used();
+	d.free();
+	return r;
+}
+
+static micro_result m_memfun_realloc_ex(size_t size)
+{
+	micro_result r = {};
+	size_t len = 0, step = 64;
+	char * p = nullptr;
+
+	while (len < size) {
+		size_t old = len;
+		char * n = memfun_t_realloc_ex(p, &len, step);
+		r.ops++;
+		if (len == old) break;
+		p = n;
+		r.grows++;
+	}
+
+	if (micro_check) {
+		if (len < size) micro_fail("length reached", len);
+		// memory is usable up to the end
+		(void) memset(p, 0x5A, len);
+		if (p[len - 1] != 0x5A) micro_fail("byte differs", len - 1);
+	}
+
+	micro_sink += len;
+	memfun_t_free(p, len);
+	return r;
+}
+
+static uvector::str<> ptrlist_source;
+
+static micro_result m_to_ptrlist(size_t count)
+{
+	micro_result r = {};
+
+	if (ptrlist_source.count() != count) {
+		ptrlist_source.free();
+		for (size_t i = 0; i < count; i++)
+			(void) ptrlist_source.append(str_source + (i % 64), 32);
+	}
+
+	size_t length = 0;
+	auto list = ptrlist_source.to_ptrlist<const char * const>(&length);
+
+	if (micro_check) {
+		for (size_t i = 0; i < count; i++) {
+			if (list[i] != ptrlist_source.get(i)) micro_fail("pointer differs", i);
+		}
+		if (list[count]) micro_fail("list is not terminated", count);
+	}
+
+	micro_sink += (size_t) list[count / 2];
+	memfun_free((void *) list, length);
+
+	r.ops = count;
+	return r;
+}
+
+// hand over filled container to another "stage": deep copy vs. swap (no allocation)
+static uvector::str<> handoff_source;
+
+static void handoff_fill(size_t count)
+{
+	if (handoff_source.count() == count) return;
+
+	handoff_source.free();
+	for (size_t i = 0; i < count; i++)
+		(void) handoff_source.append(str_source + (i % 64), 32);
+}
+
+// "s" should hold same strings as handoff_source
+static void handoff_verify(const uvector::str<> & s)
+{
+	if (s.count() != handoff_source.count()) micro_fail("strings handed over", s.count());
+	for (unsigned int i = 0; i < s.count(); i++) {
+		uvector::str_view a = s.get_view(i), b = handoff_source.get_view(i);
+		if ((a.length != b.length) || memcmp(a.ptr, b.ptr, a.length + 1))
+			micro_fail("string differs", i);
+	}
+}
+
+static micro_result m_str_copy(size_t count)
+{
+	micro_result r = { 1, 0 };
+	handoff_fill(count);
+
+	uvector::str<> spawn(handoff_source);
+	if (micro_check) handoff_verify(spawn);
+	micro_sink += (size_t) spawn.get(count / 2);
+	spawn.free();
+	return r;
+}
+
+static micro_result m_str_swap(size_t count)
+{
+	micro_result r = { 1, 0 };
+	handoff_fill(count);
+
+	uvector::str<> spawn;
+	spawn.swap(handoff_source);
+	if (micro_check && (spawn.count() != count || handoff_source.count()))
+		micro_fail("strings swapped", spawn.count());
+	micro_sink += (size_t) spawn.get(count / 2);
+	handoff_source = static_cast<uvector::str<> &&>(spawn);
+	return r;
+}
+
+// batch setup: copy initial arguments into new batch (single memcpy(3) for pool)
+static micro_result m_str_range(size_t count)
+{
+	micro_result r = { 1, 0 };
+	handoff_fill(count);
+
+	uvector::str<> batch;
+	(void) batch.append(handoff_source);
+	if (micro_check) handoff_verify(batch);
+	micro_sink += (size_t) batch.get(count / 2);
+	batch.free();
+	return r;
+}
+
+static micro_result m_dynmem_append_n(size_t count)
+{
+	micro_result r = { count, 0 };
+	uvector::dynmem<unsigned long> d;
+
+	for (size_t i = 0; i < count; i += MICRO_VALUES)
+		(void) d.append_n(values, MICRO_VALUES);
+
+	if (micro_check) {
+		size_t n = roundbyl(count, MICRO_VALUES);
+		if (d.count() != n) micro_fail("values stored", d.count());
+		for (size_t i = 0; i < n; i++) {
+			if (d.get_val(i) != values[i % MICRO_VALUES]) micro_fail("value differs", i);
+		}
+	}
+
+	micro_sink += d.get_val(count / 2);
+	d.free();
+	return r;
+}
+
+// iterate over string views (lengths come from offsets in compact layout)
+static uvector::str_compact<> views_source;
+
+static micro_result m_str_views(size_t count)
+{
+	micro_result r = { count, 0 };
+
+	if (views_source.count() != count) {
+		views_source.free();
+		for (size_t i = 0; i < count; i++)
+			(void) views_source.append(str_source + (i % 64), 1 + (i % 61));
+	}
+
+	size_t x = 0;
+	for (auto v : views_source)
+		x += v.length;
+
+	if (micro_check) {
+		size_t want = 0;
+		for (size_t i = 0; i < count; i++)
+			want += 1 + (i % 61);
+		if (x != want) micro_fail("total length", x);
+	}
+
+	micro_sink += x;
+	return r;
+}
+
+// argument de-duplication: every key is inserted twice (second pass finds it);
+// keys have no NUL bytes (like arguments) and are distinct for distinct "i" (up to 2^32)
+static void unique_key(size_t i, char * buf, size_t * length)
+{
+	*length = 8 + (i % 24);
+	(void) memcpy(buf, str_source + (i % 26), *length);
+	for (int k = 0; k < 8; k++)
+		buf[k] = 'A' + ((i >> (4 * k)) & 15);
+}
+
+static micro_result m_hashset_insert(size_t count)
+{
+	micro_result r = { 2 * count, 0 };
+	uvector::hashset<> set;
+
+	char buf[40];
+	size_t length, x = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < count; i++) {
+			unique_key(i, buf, &length);
+			int k = set.insert(buf, length);
+			x += k;
+			// first pass inserts every key, second one finds it
+			if (micro_check && (k != (pass == 0)))
+				micro_fail((pass) ? "repeated key inserted" : "key not inserted", i);
+		}
+	}
+
+	if (micro_check) {
+		if (set.count() != count) micro_fail("keys stored", set.count());
+		for (size_t i = 0; i < count; i++) {
+			unique_key(i, buf, &length);
+			uvector::str_view v = set.get_view(i);
+			if ((v.length != length) || memcmp(v.ptr, buf, length)) micro_fail("key differs", i);
+		}
+		unique_key(count, buf, &length);
+		if (set.contains(buf, length)) micro_fail("unknown key found", count);
+	}
+
+	micro_sink += x;
+	set.free();
+	return r;
+}
+
+static micro_result m_bloom_insert(size_t count)
+{
+	micro_result r = { 2 * count, 0 };
+	uvector::bloom<> filter;
+	// 32 bits per key
+	(void) filter.init(count * 4);
+
+	char buf[40];
+	size_t length, x = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < count; i++) {
+			unique_key(i, buf, &length);
+			bool fresh = filter.insert(buf, length);
+			x += fresh;
+			// no false negatives: key is known after first pass
+			if (micro_check && pass && fresh)
+				micro_fail("known key inserted again", i);
+		}
+	}
+
+	if (micro_check) {
+		for (size_t i = 0; i < count; i++) {
+			unique_key(i, buf, &length);
+			if (!filter.test(buf, length)) micro_fail("known key not found", i);
+		}
+	}
+
+	micro_sink += x;
+	filter.free();
+	return r;
+}
+
+// "--sort": sort views of string pool (order is reset each round)
+static uvector::sort_item * sort_items_buf = nullptr;
+static size_t sort_items_len = 0;
+
+static void sort_fill(size_t count)
+{
+	if (views_source.count() == count) return;
+
+	views_source.free();
+	for (size_t i = 0; i < count; i++) {
+		char buf[40];
+		size_t length;
+		unique_key(i * 0x9E3779B9U, buf, &length);
+		(void) views_source.append(buf, length);
+	}
+	memfun_t_free(sort_items_buf, sort_items_len);
+	sort_items_len = count * sizeof(uvector::sort_item);
+	sort_items_buf = memfun_t_alloc<uvector::sort_item>(sort_items_len);
+}
+
+static CC_INLINE
+const uvector::str_view & sort_view(const uvector::sort_item & item)
+{
+	return item.view;
+}
+
+static CC_INLINE
+const uvector::str_view & sort_view(const uvector::str_view & view)
+{
+	return view;
+}
+
+// views should be in order and cover all of views_source
+template<typename T>
+static void sort_verify(const T * items, size_t count)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		total += sort_view(items[i]).length;
+		if (i && (uvector::sort_compare(sort_view(items[i - 1]), sort_view(items[i])) > 0))
+			micro_fail("out of order", i);
+	}
+	// compact layout: terminators only
+	if (total != (views_source.used() - count))
+		micro_fail("total length", total);
+}
+
+static micro_result m_sort_views(size_t count)
+{
+	micro_result r = { count, 0 };
+	sort_fill(count);
+
+	uvector::sort_views(views_source, sort_items_buf);
+	if (micro_check) sort_verify(sort_items_buf, count);
+
+	micro_sink += sort_items_buf[0].view.length;
+	return r;
+}
+
+// "--sort" of large input: runs are sorted separately (as spilled runs are) and merged
+#define MICRO_SORT_RUNS  8
+
+static uvector::str_compact<> sort_runs[MICRO_SORT_RUNS];
+static uvector::str_view * sort_merged = nullptr;
+static size_t sort_merged_len = 0;
+
+static micro_result m_sort_merge(size_t count)
+{
+	micro_result r = { count, 0 };
+	sort_fill(count);
+
+	if (sort_merged_len < (count * sizeof(uvector::str_view))) {
+		memfun_t_free(sort_merged, sort_merged_len);
+		sort_merged_len = count * sizeof(uvector::str_view);
+		sort_merged = memfun_t_alloc<uvector::str_view>(sort_merged_len);
+	}
+
+	size_t pos[MICRO_SORT_RUNS], end[MICRO_SORT_RUNS];
+	for (unsigned int k = 0; k < MICRO_SORT_RUNS; k++) {
+		unsigned int first = (unsigned int) ((count * k) / MICRO_SORT_RUNS);
+		unsigned int last  = (unsigned int) ((count * (k + 1)) / MICRO_SORT_RUNS);
+
+		sort_runs[k].free();
+		(void) sort_runs[k].append(views_source, first, last - first);
+		uvector::sort_views(sort_runs[k], sort_items_buf + first);
+		pos[k] = first;
+		end[k] = first + sort_runs[k].count();
+	}
+
+	// k is small: linear selection of least head
+	for (size_t i = 0; i < count; i++) {
+		int best = -1;
+		for (int k = 0; k < MICRO_SORT_RUNS; k++) {
+			if (pos[k] >= end[k]) continue;
+			if ((best < 0) || (uvector::sort_compare(sort_items_buf[pos[k]].view, sort_items_buf[pos[best]].view) < 0))
+				best = k;
+		}
+		if (best < 0) {
+			if (micro_check) micro_fail("strings merged", i);
+			break;
+		}
+		sort_merged[i] = sort_items_buf[pos[best]++].view;
+	}
+
+	if (micro_check) sort_verify(sort_merged, count);
+
+	micro_sink += sort_merged[0].length;
+	return r;
+}
+
+// ring buffers: push then pop batches of "batch" items (single thread: cost of indices and copies)
+static uvector::ring_spsc<uvector::str_view> ring_spsc_buf;
+static uvector::ring_mpmc<uvector::str_view> ring_mpmc_buf;
+
+template<typename ring_t>
+static micro_result m_ring(ring_t & ring, size_t batch)
+{
+	static const size_t total = 65536;
+	micro_result r = { total, 0 };
+
+	if (!ring.capacity()) (void) ring.init(1024);
+
+	uvector::str_view in[64], out[64];
+	for (size_t i = 0; i < batch; i++)
+		in[i] = { str_source + i, i };
+
+	size_t x = 0;
+	for (size_t i = 0; i < total; i += batch) {
+		(void) ring.push_n(in, batch);
+		size_t n = ring.pop_n(out, batch);
+		x += n;
+
+		if (!micro_check) continue;
+		if (n != batch) micro_fail("items popped", n);
+		for (size_t k = 0; k < n; k++) {
+			if ((out[k].ptr != in[k].ptr) || (out[k].length != in[k].length))
+				micro_fail("item differs", i + k);
+		}
+	}
+
+	micro_sink += x + out[batch - 1].length;
+	return r;
+}
+
+static micro_result m_ring_spsc(size_t batch)
+{
+	return m_ring(ring_spsc_buf, batch);
+}
+
+static micro_result m_ring_mpmc(size_t batch)
+{
+	return m_ring(ring_mpmc_buf, batch);
+}
+
+// ring buffers under contention: producers push MICRO_RING_ITEMS distinct items
+// in batches of "batch", consumers pop them and count every item in "seen"
+#define MICRO_RING_ITEMS  65536
+
+static uvector::ring_spsc<size_t> ring_mt_spsc_buf;
+static uvector::ring_mpmc<size_t> ring_mt_mpmc_buf;
+static unsigned char ring_mt_seen[MICRO_RING_ITEMS];
+
+template<typename ring_t>
+struct ring_mt_shared {
+	ring_t * ring;
+	size_t batch;
+	size_t producers;
+	size_t done;
+	size_t popped;
+	size_t stray;
+};
+
+template<typename ring_t>
+struct ring_mt_thread {
+	ring_mt_shared<ring_t> * shared;
+	size_t first;
+	size_t count;
+};
+
+template<typename ring_t>
+static void * ring_mt_producer(void * arg)
+{
+	ring_mt_thread<ring_t> * t = (ring_mt_thread<ring_t> *) arg;
+	ring_t & ring = *(t->shared->ring);
+	size_t items[64];
+
+	for (size_t i = t->first, end = t->first + t->count; i < end; ) {
+		size_t n = end - i;
+		if (n > t->shared->batch) n = t->shared->batch;
+		for (size_t k = 0; k < n; k++)
+			items[k] = i + k;
+
+		// ring may accept less than asked
+		for (size_t k = 0; k < n; ) {
+			size_t m = ring.push_n(items + k, n - k);
+			if (!m) (void) sched_yield();
+			k += m;
+		}
+		i += n;
+	}
+
+	(void) __atomic_fetch_add(&t->shared->done, 1, __ATOMIC_RELEASE);
+	return nullptr;
+}
+
+template<typename ring_t>
+static void * ring_mt_consumer(void * arg)
+{
+	ring_mt_thread<ring_t> * t = (ring_mt_thread<ring_t> *) arg;
+	ring_mt_shared<ring_t> * s = t->shared;
+	size_t items[64];
+
+	for (;;) {
+		// empty ring after all producers are done: nothing is left (lost items are reported by caller)
+		size_t done = __atomic_load_n(&s->done, __ATOMIC_ACQUIRE);
+		size_t n = s->ring->pop_n(items, s->batch);
+		if (!n) {
+			if (done == s->producers)
+				break;
+			(void) sched_yield();
+			continue;
+		}
+
+		for (size_t k = 0; k < n; k++) {
+			if (items[k] < MICRO_RING_ITEMS)
+				(void) __atomic_fetch_add(&ring_mt_seen[items[k]], 1, __ATOMIC_RELAXED);
+			else
+				(void) __atomic_fetch_add(&s->stray, 1, __ATOMIC_RELAXED);
+		}
+		(void) __atomic_fetch_add(&s->popped, n, __ATOMIC_RELEASE);
+	}
+
+	return nullptr;
+}
+
+template<typename ring_t, size_t producers, size_t consumers>
+static micro_result m_ring_mt(ring_t & ring, size_t batch)
+{
+	micro_result r = { MICRO_RING_ITEMS, 0 };
+
+	if (!ring.capacity()) (void) ring.init(1024);
+	memset(ring_mt_seen, 0, sizeof(ring_mt_seen));
+
+	ring_mt_shared<ring_t> s = { &ring, batch, producers, 0, 0, 0 };
+	ring_mt_thread<ring_t> t[producers + consumers];
+	pthread_t tid[producers + consumers];
+
+	for (size_t i = 0; i < (producers + consumers); i++) {
+		t[i] = { &s, 0, 0 };
+		if (i < producers) {
+			t[i].first = (MICRO_RING_ITEMS / producers) * i;
+			t[i].count = (i == (producers - 1))
+			           ? (MICRO_RING_ITEMS - t[i].first)
+			           : (MICRO_RING_ITEMS / producers);
+		}
+		int e = pthread_create(&tid[i], nullptr,
+			(i < producers) ? ring_mt_producer<ring_t> : ring_mt_consumer<ring_t>, &t[i]);
+		if (e) micro_fail("pthread_create() failed", (size_t) e);
+	}
+	for (size_t i = 0; i < (producers + consumers); i++)
+		(void) pthread_join(tid[i], nullptr);
+
+	if (s.popped != MICRO_RING_ITEMS)
+		micro_fail("items popped", s.popped);
+	if (s.stray)
+		micro_fail("unknown items popped", s.stray);
+	for (size_t i = 0; i < MICRO_RING_ITEMS; i++) {
+		if (ring_mt_seen[i] != 1)
+			micro_fail((ring_mt_seen[i]) ? "item popped more than once" : "item lost", i);
+	}
+
+	micro_sink += s.popped;
+	return r;
+}
+
+// one producer and one consumer (the only safe use of ring_spsc)
+static micro_result m_ring_mt_spsc(size_t batch)
+{
+	return m_ring_mt<uvector::ring_spsc<size_t>, 1, 1>(ring_mt_spsc_buf, batch);
+}
+
+static micro_result m_ring_mt_mpmc(size_t batch)
+{
+	return m_ring_mt<uvector::ring_mpmc<size_t>, 2, 2>(ring_mt_mpmc_buf, batch);
+}
+
+// reference implementations for checks
+static int ref_popcnt(unsigned long v)
+{
+	int n = 0;
+	for (; v; v &= v - 1) n++;
+	return n;
+}
+
+static int ref_getmsb(unsigned long v)
+{
+	int n = 0;
+	for (; v; v >>= 1) n++;
+	return n;
+}
+
+static micro_result m_popcnt(size_t)
+{
+	micro_result r = { MICRO_VALUES, 0 };
+	size_t x = 0;
+	for (size_t i = 0; i < MICRO_VALUES; i++)
+		x += popcntl(values[i]);
+
+	if (micro_check) {
+		for (size_t i = 0; i < MICRO_VALUES; i++) {
+			if (popcntl(values[i]) != ref_popcnt(values[i])) micro_fail("value differs", i);
+		}
+	}
+
+	micro_sink += x;
+	return r;
+}
+
+static micro_result m_getmsb(size_t)
+{
+	micro_result r = { MICRO_VALUES, 0 };
+	size_t x = 0;
+	for (size_t i = 0; i < MICRO_VALUES; i++)
+		x += getmsbl(values[i]);
+
+	if (micro_check) {
+		for (size_t i = 0; i < MICRO_VALUES; i++) {
+			if (getmsbl(values[i]) != ref_getmsb(values[i])) micro_fail("value differs", i);
+		}
+	}
+
+	micro_sink += x;
+	return r;
+}
+
+static micro_result m_degree2_next(size_t)
+{
+	micro_result r = { MICRO_VALUES, 0 };
+	size_t x = 0;
+	for (size_t i = 0; i < MICRO_VALUES; i++)
+		x += degree2_nextl(values[i] >> 2);
+
+	if (micro_check) {
+		// values are shifted so result doesn't overflow
+		for (size_t i = 0; i < MICRO_VALUES; i++) {
+			if (degree2_nextl(values[i] >> 2) != (1UL << ref_getmsb(values[i] >> 2))) micro_fail("value differs", i);
+		}
+	}
+
+	micro_sink += x;
+	return r;
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc > 1) micro_filter = argv[1];
+
+	for (size_t i = 0; i < sizeof(str_source); i++)
+		str_source[i] = 'a' + (i % 26);
+
+	uint64_t prng = 0x9E3779B97F4A7C15ULL;
+	for (size_t i = 0; i < MICRO_VALUES; i++) {
+		prng ^= prng >> 12; prng ^= prng << 25; prng ^= prng >> 27;
+		// spread values over all magnitudes
+		values[i] = (prng * 0x2545F4914F6CDD1DULL) >> (i % 64);
+	}
+
+	printf("case\tparam\tops\tns_per_op\tgrows%s\n",
+		(MEMFUN_STATS) ? "\tallocs\tmoved\tcopied\tzeroed" : "");
+
+	static const size_t str_lengths[] = { 8, 32, 256, 4096 };
+	for (auto x : str_lengths)
+		micro_run("str_append", x, m_str_append, 1);
+
+	for (auto x : str_lengths)
+		micro_run("str_compact", x, m_str_compact, 1);
+
+	for (auto x : str_lengths)
+		micro_run("str_arena", x, m_str_arena, 1);
+	arena_destroy(&micro_arena);
+
+	static const size_t dynmem_counts[] = { 1024, 65536, 1048576 };
+	for (auto x : dynmem_counts)
+		micro_run("dynmem_append", x, m_dynmem_append, 1);
+	for (auto x : dynmem_counts)
+		micro_run("dynmem_grow_auto", x, m_dynmem_grow_auto, 1);
+	for (auto x : dynmem_counts)
+		micro_run("dynmem_append_n", x, m_dynmem_append_n, 0);
+
+	static const size_t small_counts[] = { 8, 32 };
+	for (auto x : small_counts)
+		micro_run("small_dynmem", x, m_small_append<uvector::dynmem<size_t>>, 0);
+	for (auto x : small_counts)
+		micro_run("small_hybrid", x, m_small_append<uvector::hybrid<size_t, size_t, 32>>, 0);
+
+	static const size_t realloc_sizes[] = { 65536, 1048576, 16777216 };
+	for (auto x : realloc_sizes)
+		micro_run("memfun_realloc_ex", x, m_memfun_realloc_ex, 1);
+
+	static const size_t policy_sizes[] = { 65536, 2097152, 16777216 };
+	for (auto x : policy_sizes)
+		micro_run("str_policy_block", x, m_str_policy<MEMFUN_GROWTH_BLOCK>, 1);
+	for (auto x : policy_sizes)
+		micro_run("str_policy_geo1.5", x, m_str_policy<MEMFUN_GROWTH_GEOMETRIC(12)>, 1);
+	for (auto x : policy_sizes)
+		micro_run("str_policy_geo2", x, m_str_policy<MEMFUN_GROWTH_GEOMETRIC(16)>, 1);
+
+	static const size_t policy_counts[] = { 65536, 1048576 };
+	for (auto x : policy_counts)
+		micro_run("dynmem_policy_block", x, m_dynmem_policy<MEMFUN_GROWTH_BLOCK>, 1);
+	for (auto x : policy_counts)
+		micro_run("dynmem_policy_geo1.5", x, m_dynmem_policy<MEMFUN_GROWTH_GEOMETRIC(12)>, 1);
+
+	static const size_t ptrlist_counts[] = { 16, 1024, 65536 };
+	for (auto x : ptrlist_counts)
+		micro_run("to_ptrlist", x, m_to_ptrlist, 0);
+	ptrlist_source.free();
+
+	static const size_t handoff_counts[] = { 1024, 65536 };
+	for (auto x : handoff_counts)
+		micro_run("str_copy", x, m_str_copy, 0);
+	for (auto x : handoff_counts)
+		micro_run("str_swap", x, m_str_swap, 0);
+	for (auto x : handoff_counts)
+		micro_run("str_range", x, m_str_range, 0);
+	for (auto x : handoff_counts)
+		micro_run("str_views", x, m_str_views, 0);
+	views_source.free();
+	handoff_source.free();
+
+	static const size_t unique_counts[] = { 1024, 65536, 1048576 };
+	for (auto x : unique_counts)
+		micro_run("hashset_insert", x, m_hashset_insert, 0);
+	for (auto x : unique_counts)
+		micro_run("bloom_insert", x, m_bloom_insert, 0);
+
+	static const size_t sort_counts[] = { 1024, 65536 };
+	for (auto x : sort_counts)
+		micro_run("sort_views", x, m_sort_views, 0);
+	for (auto x : sort_counts)
+		micro_run("sort_merge", x, m_sort_merge, 0);
+	views_source.free();
+	for (auto & x : sort_runs)
+		x.free();
+	memfun_t_free(sort_items_buf, sort_items_len);
+	memfun_t_free(sort_merged, sort_merged_len);
+
+	static const size_t ring_batches[] = { 1, 64 };
+	for (auto x : ring_batches)
+		micro_run("ring_spsc", x, m_ring_spsc, 0);
+	for (auto x : ring_batches)
+		micro_run("ring_mpmc", x, m_ring_mpmc, 0);
+	ring_spsc_buf.free();
+	ring_mpmc_buf.free();
+
+	for (auto x : ring_batches)
+		micro_run("ring_mt_spsc", x, m_ring_mt_spsc, 0);
+	for (auto x : ring_batches)
+		micro_run("ring_mt_mpmc", x, m_ring_mt_mpmc, 0);
+	ring_mt_spsc_buf.free();
+	ring_mt_mpmc_buf.free();
+
+	micro_run("popcnt", 64, m_popcnt, 0);
+	micro_run("getmsb", 64, m_getmsb, 0);
+	micro_run("degree2_next", 64, m_degree2_next, 0);
+
+	return 0;
+}
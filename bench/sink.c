@@ -0,0 +1,25 @@
+/* sink: no-op program for benchmarks
+ *
+ * If file descriptor 3 is open then line "<argc> <bytes>" is written to it
+ * on every invocation so caller is able to count batches.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char * argv[])
+{
+	size_t bytes = 0;
+	for (int i = 1; i < argc; i++)
+		bytes += strlen(argv[i]) + 1;
+
+	char b[64];
+	int n = snprintf(b, sizeof(b), "%d %zu\n", argc - 1, bytes);
+	if (n > 0) (void) write(3, b, n);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+/* timeit: run command and report its resource usage
+ *
+ * Usage: timeit <program> [..<args>]
+ *
+ * Prints "<wall> <user> <sys> <max rss>" to stdout (seconds and KiB),
+ * program's own stdout is redirected to /dev/null.
+ * Return code is program's return code.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <rockdrilla/misc/monotime.h>
+
+static double tv_sec(const struct timeval * tv)
+{
+	return (double) tv->tv_sec + ((double) tv->tv_usec / 1e6);
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc < 2) {
+		fputs("Usage: timeit <program> [..<args>]\n", stderr);
+		return EINVAL;
+	}
+
+	fflush(stdout);
+
+	uint64_t start = monotime_ns();
+
+	pid_t child = fork();
+	if (child < 0) {
+		perror("timeit: fork(2)");
+		return errno;
+	}
+	if (child == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			if (fd != STDOUT_FILENO) close(fd);
+		}
+		execvp(argv[1], argv + 1);
+		perror("timeit: execvp(3)");
+		_exit(127);
+	}
+
+	int status = 0;
+	struct rusage ru;
+	if (wait4(child, &status, 0, &ru) < 0) {
+		perror("timeit: wait4(2)");
+		return errno;
+	}
+
+	uint64_t wall = monotime_ns() - start;
+
+	printf("%.6f %.6f %.6f %ld\n",
+		(double) wall / 1e9, tv_sec(&ru.ru_utime), tv_sec(&ru.ru_stime), ru.ru_maxrss);
+
+	if (WIFEXITED(status)) return WEXITSTATUS(status);
+	return 128 + WTERMSIG(status);
+}
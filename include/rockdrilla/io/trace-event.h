@@ -0,0 +1,171 @@
+/* trace-event: write Chrome trace-event (JSON array format) file
+ *
+ * Events are buffered in memory and written with write(2) only,
+ * so forked child process doesn't duplicate pending events
+ * unless it calls trace_event_flush() itself.
+ *
+ * File is started with "[" and closing "]" is written by trace_event_close();
+ * trace viewers accept file without closing "]" too (i.e. after crash).
+ * Write error (e.g. ENOSPC or EPIPE) closes trace: remaining events are dropped
+ * rather than (partially) written again.
+ *
+ * Timestamps and durations are in nanoseconds (and are written in microseconds).
+ * Event names and categories are not escaped, "args" is JSON object body
+ * (i.e. "\"bytes\":42") or NULL.
+ *
+ * refs:
+ * - [1] https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+ * - [2] https://ui.perfetto.dev/
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_IO_TRACE_EVENT
+#define HEADER_INCLUDED_IO_TRACE_EVENT 1
+
+#include "../misc/ext-c-begin.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef TRACE_EVENT_BUFFER
+#define TRACE_EVENT_BUFFER  65536
+#endif
+
+// maximum length of single event record
+#define _TRACE_EVENT_RECORD  1024
+
+typedef struct {
+	int fd;
+	unsigned int count;
+	size_t used;
+	char buffer[TRACE_EVENT_BUFFER];
+} trace_event;
+
+static
+void trace_event_printf(trace_event * t, const char * fmt, ...)
+__attribute__((format (printf, 2, 3)));
+
+static
+int trace_event_flush(trace_event * t)
+{
+	if (t->fd < 0) return 0;
+
+	size_t x = 0;
+	while (x < t->used) {
+		ssize_t r = write(t->fd, t->buffer + x, t->used - x);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			(void) close(t->fd);
+			t->fd = -1;
+			t->used = 0;
+			return 0;
+		}
+		x += r;
+	}
+
+	t->used = 0;
+	return 1;
+}
+
+static
+int trace_event_open(trace_event * t, const char * path)
+{
+	t->count = 0;
+	t->used = 0;
+	t->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (t->fd < 0) return 0;
+
+	t->buffer[t->used++] = '[';
+	return 1;
+}
+
+static
+void trace_event_close(trace_event * t)
+{
+	if (t->fd < 0) return;
+
+	t->buffer[t->used++] = '\n';
+	t->buffer[t->used++] = ']';
+	t->buffer[t->used++] = '\n';
+	if (!trace_event_flush(t)) return;
+
+	(void) close(t->fd);
+	t->fd = -1;
+}
+
+static
+void trace_event_printf(trace_event * t, const char * fmt, ...)
+{
+	if (t->fd < 0) return;
+
+	if ((t->used + _TRACE_EVENT_RECORD) > sizeof(t->buffer)) {
+		if (!trace_event_flush(t)) return;
+	}
+
+	// room for separator and (possible) closing
+	size_t avail = sizeof(t->buffer) - t->used - 8;
+	// separator takes up to 2 bytes and record needs at least terminating NUL
+	if (avail <= 2) return;
+
+	char * p = t->buffer + t->used;
+	size_t x = 0;
+
+	if (t->count) p[x++] = ',';
+	p[x++] = '\n';
+
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(p + x, avail - x, fmt, args);
+	va_end(args);
+
+	// drop truncated record
+	if ((n < 0) || ((size_t) n >= (avail - x))) return;
+
+	t->used += x + n;
+	t->count++;
+}
+
+#define _TRACE_EVENT_TS(ns)  (unsigned long long) ((ns) / 1000), (unsigned int) ((ns) % 1000)
+
+static
+void trace_event_complete(trace_event * t, const char * name, const char * cat, int pid, int tid, uint64_t ts, uint64_t dur, const char * args)
+{
+	trace_event_printf(t,
+		"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"args\":{%s}}",
+		name, cat, pid, tid, _TRACE_EVENT_TS(ts), _TRACE_EVENT_TS(dur), (args) ? args : "");
+}
+
+static
+void trace_event_instant(trace_event * t, const char * name, const char * cat, int pid, int tid, uint64_t ts, const char * args)
+{
+	trace_event_printf(t,
+		"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u,\"args\":{%s}}",
+		name, cat, pid, tid, _TRACE_EVENT_TS(ts), (args) ? args : "");
+}
+
+static
+void trace_event_process_name(trace_event * t, int pid, const char * name)
+{
+	trace_event_printf(t,
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		pid, pid, name);
+}
+
+static
+void trace_event_thread_name(trace_event * t, int pid, int tid, const char * name)
+{
+	trace_event_printf(t,
+		"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		pid, tid, name);
+}
+
+#include "../misc/ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_IO_TRACE_EVENT */
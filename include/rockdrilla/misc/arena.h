@@ -0,0 +1,290 @@
+/* arena: bump allocator with O(1) reset
+ *
+ * Memory is taken from list of chunks; freeing of individual blocks is no-op
+ * (except the most recent block), all memory is released at once with arena_reset()
+ * while chunks are kept for reuse.
+ * Top (most recent) block is grown in place if there's enough room in chunk;
+ * large blocks get their own chunks so they're grown in place too.
+ *
+ * arena_alloc() and arena_realloc() return zeroed memory,
+ * _arena_alloc() and _arena_realloc() leave it as is.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_ARENA
+#define HEADER_INCLUDED_ARENA 1
+
+#include "ext-c-begin.h"
+
+#include <string.h>
+
+#include "cc-inline.h"
+#include "memfun.h"
+#include "../num/uadd.h"
+
+#ifndef ARENA_CHUNK
+#define ARENA_CHUNK  (256 * 1024)
+#endif
+
+// blocks of this size (and larger) get their own chunks
+#ifndef ARENA_LARGE
+#define ARENA_LARGE  (ARENA_CHUNK / 4)
+#endif
+
+#define _ARENA_ALIGN  (2 * sizeof(size_t))
+
+typedef struct arena_chunk {
+	struct arena_chunk * next;
+	size_t size, used;
+	// "data" is aligned at _ARENA_ALIGN
+	size_t _pad;
+	char data[];
+} arena_chunk;
+
+typedef struct {
+	arena_chunk * head, * curr;
+	// top block (candidate for in-place growth)
+	char * top;
+} arena;
+
+static CC_FORCE_INLINE
+size_t _arena_align(size_t length)
+{
+	return (length + (_ARENA_ALIGN - 1)) & ~(_ARENA_ALIGN - 1);
+}
+
+static
+arena_chunk * _arena_chunk_new(size_t length)
+{
+	size_t size = (length > ARENA_CHUNK) ? length : ARENA_CHUNK;
+	size_t total = 0;
+	if (!uaddl(size, sizeof(arena_chunk), &total))
+		return NULL;
+
+	// chunk may be larger than requested
+	arena_chunk * c = (arena_chunk *) memfun_alloc_flags(&total, 0);
+	if (!c) return NULL;
+
+	c->next = NULL;
+	c->size = total - sizeof(arena_chunk);
+	c->used = 0;
+	return c;
+}
+
+// unlink free chunk with at least "length" bytes:
+// smallest one (so larger ones are left for larger blocks) or largest one (room for growth);
+// new chunk is allocated if there's no such chunk
+static
+arena_chunk * _arena_chunk_take(arena * a, size_t length, int largest)
+{
+	// chunks after current one are free (after arena_reset())
+	arena_chunk ** pn = (a->curr) ? &(a->curr->next) : &(a->head);
+	arena_chunk ** pbest = NULL;
+	arena_chunk * n;
+	for (n = *pn; n; pn = &(n->next), n = n->next) {
+		if (n->size < length) continue;
+		if (pbest) {
+			if (largest && ((*pbest)->size >= n->size)) continue;
+			if (!largest && ((*pbest)->size <= n->size)) continue;
+		}
+		pbest = pn;
+	}
+
+	if (pbest) {
+		n = *pbest;
+		*pbest = n->next;
+	} else {
+		size_t size = length;
+		// room for growth
+		if (largest && !uaddl(length, length, &size))
+			size = length;
+		n = _arena_chunk_new(size);
+		if (!n) return NULL;
+	}
+
+	n->next = NULL;
+	n->used = 0;
+	return n;
+}
+
+// returns chunk (current or next one) with at least "length" free bytes
+static
+arena_chunk * _arena_chunk_room(arena * a, size_t length)
+{
+	arena_chunk * c = a->curr;
+	if (c && ((c->size - c->used) >= length))
+		return c;
+
+	arena_chunk * n = _arena_chunk_take(a, length, 0);
+	if (!n) return NULL;
+
+	// move chunk right after current one
+	if (c) {
+		n->next = c->next;
+		c->next = n;
+	} else {
+		n->next = a->head;
+		a->head = n;
+	}
+
+	a->curr = n;
+	return n;
+}
+
+// large block gets its own chunk (which is placed at list head)
+// so it may be grown in place regardless of other blocks
+static
+void * _arena_alloc_large(arena * a, size_t len)
+{
+	// list head is "used" only if there's current chunk
+	if ((!a->curr) && (!_arena_chunk_room(a, 1)))
+		return NULL;
+
+	arena_chunk * c = _arena_chunk_take(a, len, 1);
+	if (!c) return NULL;
+
+	c->used = len;
+	c->next = a->head;
+	a->head = c;
+
+	return c->data;
+}
+
+// memory is not zeroed
+static
+void * _arena_alloc(arena * a, size_t length)
+{
+	if (!length) return NULL;
+
+	size_t len = _arena_align(length);
+	if (len < length) return NULL;
+
+	if (len >= ARENA_LARGE)
+		return _arena_alloc_large(a, len);
+
+	arena_chunk * c = _arena_chunk_room(a, len);
+	if (!c) return NULL;
+
+	char * ptr = c->data + c->used;
+	c->used += len;
+	a->top = ptr;
+
+	return ptr;
+}
+
+static
+void * arena_alloc(arena * a, size_t length)
+{
+	void * ptr = _arena_alloc(a, length);
+	if (ptr) {
+		(void) memset(ptr, 0, _arena_align(length));
+		memfun_stats_zeroed(_arena_align(length));
+	}
+	return ptr;
+}
+
+static CC_INLINE
+int _arena_is_top(const arena * a, const void * ptr)
+{
+	return (ptr && (ptr == a->top));
+}
+
+// returns chunk if "ptr" is the last block in it
+static
+arena_chunk * _arena_chunk_of(const arena * a, const void * ptr, size_t len)
+{
+	if (_arena_is_top(a, ptr)) return a->curr;
+
+	// large blocks
+	for (arena_chunk * c = a->head; c && (c != a->curr); c = c->next) {
+		if (c->data != ptr) continue;
+		return (c->used == len) ? c : NULL;
+	}
+
+	return NULL;
+}
+
+// "length" is allocated length of "ptr"; returns NULL on failure (and "ptr" remains valid);
+// grown part is zeroed if "zero" is set
+static
+void * _arena_realloc(arena * a, void * ptr, size_t length, size_t new_length, int zero)
+{
+	if (!ptr) return (zero) ? arena_alloc(a, new_length) : _arena_alloc(a, new_length);
+
+	size_t len = _arena_align(length), new_len = _arena_align(new_length);
+	if (new_len < new_length) return NULL;
+	if (new_len <= len) return ptr;
+
+	arena_chunk * c = _arena_chunk_of(a, ptr, len);
+	if (c) {
+		size_t offset = (char *) ptr - c->data;
+		if ((c->size - offset) >= new_len) {
+			if (zero) {
+				(void) memset((char *) ptr + len, 0, new_len - len);
+				memfun_stats_zeroed(new_len - len);
+			}
+			c->used = offset + new_len;
+			return ptr;
+		}
+	}
+
+	void * nptr = _arena_alloc(a, new_len);
+	if (!nptr) return NULL;
+
+	(void) memcpy(nptr, ptr, len);
+	if (zero) {
+		(void) memset((char *) nptr + len, 0, new_len - len);
+		memfun_stats_zeroed(new_len - len);
+	}
+	return nptr;
+}
+
+static CC_FORCE_INLINE
+void * arena_realloc(arena * a, void * ptr, size_t length, size_t new_length)
+{
+	return _arena_realloc(a, ptr, length, new_length, 1);
+}
+
+// only top block is really released
+static
+void arena_free(arena * a, void * ptr, size_t length)
+{
+	if (!_arena_is_top(a, ptr)) return;
+
+	arena_chunk * c = a->curr;
+	size_t len = _arena_align(length);
+	size_t offset = (char *) ptr - c->data;
+	if ((offset + len) != c->used) return;
+
+	c->used = offset;
+	a->top = NULL;
+}
+
+// release all blocks at once (chunks are kept)
+static CC_INLINE
+void arena_reset(arena * a)
+{
+	a->curr = a->head;
+	if (a->curr) a->curr->used = 0;
+	a->top = NULL;
+}
+
+// release all chunks
+static
+void arena_destroy(arena * a)
+{
+	arena_chunk * c = a->head, * n;
+	while (c) {
+		n = c->next;
+		memfun_free_flags(c, c->size + sizeof(arena_chunk), 0);
+		c = n;
+	}
+
+	(void) memset(a, 0, sizeof(*a));
+}
+
+#include "ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_ARENA */
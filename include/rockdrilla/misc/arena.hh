@@ -0,0 +1,62 @@
+/* arena: bump allocator with O(1) reset (c++-like version)
+ *
+ * Allocator for uvector containers which is bound to arena with static storage, e.g.:
+ *   static arena batch_arena;
+ *   uvector::str<unsigned int, MEMFUN_GROWTH_DEFAULT, arena_allocator<&batch_arena>> s;
+ *
+ * "flags" is set of MEMFUN_ZERO and MEMFUN_SENSITIVE (see memfun.h).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_ARENA_HH
+#define HEADER_INCLUDED_ARENA_HH 1
+
+#include "arena.h"
+#include "memfun.hh"
+
+template<arena * a, unsigned int flags = 0>
+struct arena_allocator {
+
+	static
+	void * alloc_ex(size_t * length) {
+		if (!length) return nullptr;
+
+		void * ptr = (flags & MEMFUN_ZERO) ? arena_alloc(a, *length) : _arena_alloc(a, *length);
+		if (!ptr) return nullptr;
+
+		*length = _arena_align(*length);
+		return ptr;
+	}
+
+	static
+	void * realloc_policy(void * ptr, size_t * length, size_t extend, unsigned int policy) {
+		if (!length) return ptr;
+
+		size_t _new = memfun_growth_calc(*length, extend, policy);
+		if (_new <= *length) return ptr;
+
+		void * nptr = _arena_realloc(a, ptr, *length, _new, (flags & MEMFUN_ZERO));
+		if (!nptr) return ptr;
+
+		if ((flags & MEMFUN_SENSITIVE) && (nptr != ptr))
+			memfun_wipe(ptr, *length);
+
+		*length = _new;
+		return nptr;
+	}
+
+	static
+	void free(void * ptr, size_t length) {
+		if (!ptr) return;
+
+		if (flags & MEMFUN_SENSITIVE)
+			memfun_wipe(ptr, length);
+
+		arena_free(a, ptr, length);
+	}
+
+};
+
+#endif /* HEADER_INCLUDED_ARENA_HH */
@@ -0,0 +1,191 @@
+/* cpufeat: CPU features and one-time selection of implementation
+ *
+ * - cpufeat() returns mask of CPUFEAT_* bits:
+ *   - x86: __builtin_cpu_supports() (cpuid);
+ *   - aarch64 (Linux): getauxval(AT_HWCAP);
+ *   - features enabled in build time (e.g. with "-march=...") are reported unconditionally;
+ * - CPUFEAT_DISPATCH(name, ret, params, resolver) declares function "name"
+ *   which implementation is returned by "resolver" (i.e. "ret (*)params"):
+ *   - with GNU indirect functions [1] (x86, glibc): resolver is called once
+ *     by dynamic linker while program is loaded;
+ *   - otherwise: function pointer which points to resolving stub until first call;
+ *   either way there's no per-call check (but call is indirect so implementation
+ *   should be worth it, e.g. it's "target"-specific variant of loop or instruction
+ *   which is missing in baseline ISA);
+ * - CPUFEAT_TARGET(x) marks function as compiled for extra ISA extensions
+ *   (e.g. CPUFEAT_TARGET("avx2")).
+ *
+ * Nota bene: resolvers are called before constructors and dynamic linker
+ * may not have relocated everything yet, so resolver should call nothing except cpufeat().
+ *
+ * refs:
+ * - [1] https://gcc.gnu.org/onlinedocs/gcc/Common-Function-Attributes.html#index-ifunc-function-attribute
+ * - [2] https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_CPUFEAT
+#define HEADER_INCLUDED_CPUFEAT 1
+
+#include "ext-c-begin.h"
+
+#include <limits.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#include "cc-inline.h"
+
+#define CPUFEAT_POPCNT    (1U << 0)
+#define CPUFEAT_LZCNT     (1U << 1)
+#define CPUFEAT_BMI2      (1U << 2)
+#define CPUFEAT_SSE42     (1U << 3)
+#define CPUFEAT_AVX2      (1U << 4)
+#define CPUFEAT_AVX512F   (1U << 5)
+#define CPUFEAT_AVX512BW  (1U << 6)
+#define CPUFEAT_ASIMD     (1U << 7)
+#define CPUFEAT_SVE       (1U << 8)
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define _CPUFEAT_X86 1
+#endif
+
+#ifdef __has_builtin
+  #if __has_builtin(__builtin_cpu_init)
+  #if __has_builtin(__builtin_cpu_supports)
+    #ifndef _CPUFEAT_HAVE_CPU_SUPPORTS
+    #define _CPUFEAT_HAVE_CPU_SUPPORTS 1
+    #endif
+  #endif /* __has_builtin(__builtin_cpu_supports) */
+  #endif /* __has_builtin(__builtin_cpu_init) */
+#endif /* __has_builtin */
+#ifndef _CPUFEAT_HAVE_CPU_SUPPORTS
+#define _CPUFEAT_HAVE_CPU_SUPPORTS 0
+#endif
+
+// sanitizers aren't initialized yet when resolvers are called
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+  #ifndef CPUFEAT_NO_IFUNC
+  #define CPUFEAT_NO_IFUNC 1
+  #endif
+#endif
+#ifdef __has_feature
+  #if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+    #ifndef CPUFEAT_NO_IFUNC
+    #define CPUFEAT_NO_IFUNC 1
+    #endif
+  #endif
+#endif /* __has_feature */
+
+// musl doesn't support indirect functions
+#ifndef CPUFEAT_NO_IFUNC
+  #if defined(_CPUFEAT_X86) && defined(__ELF__) && defined(__GLIBC__) && _CPUFEAT_HAVE_CPU_SUPPORTS
+    #define CPUFEAT_HAVE_IFUNC 1
+  #endif
+#endif /* ! CPUFEAT_NO_IFUNC */
+#ifndef CPUFEAT_HAVE_IFUNC
+#define CPUFEAT_HAVE_IFUNC 0
+#endif
+
+#define CPUFEAT_TARGET(x)  __attribute__((target(x)))
+
+// features which compiler may use anywhere
+static CC_FORCE_INLINE
+unsigned int _cpufeat_build(void)
+{
+	unsigned int f = 0;
+#ifdef __POPCNT__
+	f |= CPUFEAT_POPCNT;
+#endif
+#ifdef __LZCNT__
+	f |= CPUFEAT_LZCNT;
+#endif
+#ifdef __BMI2__
+	f |= CPUFEAT_BMI2;
+#endif
+#ifdef __SSE4_2__
+	f |= CPUFEAT_SSE42;
+#endif
+#ifdef __AVX2__
+	f |= CPUFEAT_AVX2;
+#endif
+#ifdef __AVX512F__
+	f |= CPUFEAT_AVX512F;
+#endif
+#ifdef __AVX512BW__
+	f |= CPUFEAT_AVX512BW;
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+	f |= CPUFEAT_ASIMD;
+#endif
+#ifdef __ARM_FEATURE_SVE
+	f |= CPUFEAT_SVE;
+#endif
+	return f;
+}
+
+static
+unsigned int cpufeat(void)
+{
+	unsigned int f = _cpufeat_build();
+
+#if defined(_CPUFEAT_X86) && _CPUFEAT_HAVE_CPU_SUPPORTS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))   f |= CPUFEAT_POPCNT;
+	if (__builtin_cpu_supports("bmi2"))     f |= CPUFEAT_BMI2;
+	if (__builtin_cpu_supports("sse4.2"))   f |= CPUFEAT_SSE42;
+	if (__builtin_cpu_supports("avx2"))     f |= CPUFEAT_AVX2;
+	if (__builtin_cpu_supports("avx512f"))  f |= CPUFEAT_AVX512F;
+	if (__builtin_cpu_supports("avx512bw")) f |= CPUFEAT_AVX512BW;
+  #if __GNUC__ >= 11 || defined(__clang__)
+	if (__builtin_cpu_supports("lzcnt"))    f |= CPUFEAT_LZCNT;
+  #else
+	// "abm" implies "lzcnt"
+	if (__builtin_cpu_supports("abm"))      f |= CPUFEAT_LZCNT;
+  #endif
+#endif /* _CPUFEAT_X86 && _CPUFEAT_HAVE_CPU_SUPPORTS */
+
+#if defined(__aarch64__) && defined(__linux__)
+	unsigned long hwcap = getauxval(AT_HWCAP);
+  #ifdef HWCAP_ASIMD
+	if (hwcap & HWCAP_ASIMD) f |= CPUFEAT_ASIMD;
+  #endif
+  #ifdef HWCAP_SVE
+	if (hwcap & HWCAP_SVE)   f |= CPUFEAT_SVE;
+  #endif
+	(void) hwcap;
+#endif /* __aarch64__ && __linux__ */
+
+	return f;
+}
+
+#if CPUFEAT_HAVE_IFUNC
+
+#define CPUFEAT_DISPATCH(name, ret, params, resolver) \
+	static ret name params __attribute__((ifunc(#resolver)));
+
+#else /* ! CPUFEAT_HAVE_IFUNC */
+
+#define CPUFEAT_DISPATCH(name, ret, params, resolver) \
+	static ret name ## _first params; \
+	static ret (* name) params = name ## _first;
+
+// stub replaces pointer and calls implementation
+#define CPUFEAT_DISPATCH_STUB(name, ret, params, args, resolver) \
+	static ret name ## _first params { \
+		__atomic_store_n(&name, resolver(), __ATOMIC_RELAXED); \
+		return name args; \
+	}
+
+#endif /* CPUFEAT_HAVE_IFUNC */
+
+#ifndef CPUFEAT_DISPATCH_STUB
+#define CPUFEAT_DISPATCH_STUB(name, ret, params, args, resolver)
+#endif
+
+#include "ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_CPUFEAT */
@@ -0,0 +1,119 @@
+/* file-locality: sort key for on-disk location of file
+ *
+ * Key is (device, kind, value) where value is either:
+ * - physical offset of first extent (FILE_LOCALITY_EXTENT),
+ *   taken with ioctl(FS_IOC_FIEMAP) if requested and supported by file system;
+ * - inode number (FILE_LOCALITY_INODE): most file systems allocate inodes
+ *   (and often data) close to each other for files created together;
+ * - nothing (FILE_LOCALITY_NONE): file can't be stat'ed.
+ *
+ * statx(2) is used (if available) with minimal mask and AT_STATX_DONT_SYNC
+ * so network file systems may answer from cache.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_FILE_LOCALITY
+#define HEADER_INCLUDED_FILE_LOCALITY 1
+
+#include "ext-c-begin.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+enum {
+	FILE_LOCALITY_EXTENT = 0,
+	FILE_LOCALITY_INODE,
+	FILE_LOCALITY_NONE,
+	FILE_LOCALITY_COUNT
+};
+
+typedef struct {
+	uint64_t dev;
+	uint64_t value;
+	uint32_t kind;
+} file_locality;
+
+// physical offset of first extent (if it's known)
+static
+int _file_locality_extent(const char * path, uint64_t * value)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) return 0;
+
+	// room for single extent
+	uint64_t buf[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(uint64_t) + 1];
+	struct fiemap * fm = (struct fiemap *) buf;
+	(void) memset(buf, 0, sizeof(buf));
+	fm->fm_length = FIEMAP_MAX_OFFSET;
+	fm->fm_extent_count = 1;
+
+	int r = ioctl(fd, FS_IOC_FIEMAP, fm);
+	(void) close(fd);
+
+	if (r < 0) return 0;
+	if (!fm->fm_mapped_extents) return 0;
+	// location is not known (yet) or data isn't stored in blocks
+	if (fm->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_DATA_INLINE))
+		return 0;
+
+	*value = fm->fm_extents[0].fe_physical;
+	return 1;
+}
+
+// returns kind of key
+static
+int file_locality_get(const char * path, int extent, file_locality * l)
+{
+	(void) memset(l, 0, sizeof(*l));
+	// files which can't be stat'ed go last
+	l->dev = UINT64_MAX;
+	l->kind = FILE_LOCALITY_NONE;
+
+	int regular;
+#ifdef STATX_INO
+	struct statx stx;
+	if (statx(AT_FDCWD, path, AT_STATX_DONT_SYNC, STATX_TYPE | STATX_INO, &stx) < 0)
+		return l->kind;
+
+	l->dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	l->value = stx.stx_ino;
+	regular = S_ISREG(stx.stx_mode);
+#else
+	struct stat st;
+	if (stat(path, &st) < 0)
+		return l->kind;
+
+	l->dev = st.st_dev;
+	l->value = st.st_ino;
+	regular = S_ISREG(st.st_mode);
+#endif
+	l->kind = FILE_LOCALITY_INODE;
+
+	if (extent && regular && _file_locality_extent(path, &(l->value)))
+		l->kind = FILE_LOCALITY_EXTENT;
+
+	return l->kind;
+}
+
+static
+int file_locality_compare(const file_locality * a, const file_locality * b)
+{
+	if (a->dev != b->dev) return (a->dev < b->dev) ? -1 : 1;
+	if (a->kind != b->kind) return (a->kind < b->kind) ? -1 : 1;
+	if (a->value != b->value) return (a->value < b->value) ? -1 : 1;
+	return 0;
+}
+
+#include "ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_FILE_LOCALITY */
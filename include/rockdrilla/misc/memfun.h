@@ -29,6 +29,24 @@
 // #define MEMFUN_PAGE           _MEMFUN_PAGE_DEFAULT
 // #define MEMFUN_BLOCK          _MEMFUN_BLOCK_DEFAULT
 // #define MEMFUN_GROWTH_FACTOR  _MEMFUN_GROWTH_FACTOR_DEFAULT
+// #define MEMFUN_GROWTH_POLICY  _MEMFUN_GROWTH_POLICY_DEFAULT
+
+/* growth policy: how much memory to reallocate when more is needed
+ *
+ * - MEMFUN_GROWTH_BLOCK: requested length rounded up to block
+ *   (linear growth; realloc every few KiB; allocation granularity is block anyway,
+ *   so there's no "exact" policy);
+ * - MEMFUN_GROWTH_GEOMETRIC(x8): at least current length multiplied by (x8 / 8),
+ *   rounded up to block (amortized O(1) append);
+ *   x8 is in range [9, 255], i.e. 12 is 1.5x and 16 is 2x.
+ */
+#define MEMFUN_GROWTH_BLOCK          0x100U
+#define MEMFUN_GROWTH_GEOMETRIC(x8)  (0x200U | ((x8) & 0xFFU))
+
+#define _MEMFUN_GROWTH_KIND_MASK  0xF00U
+#define _MEMFUN_GROWTH_X8_MASK    0x0FFU
+
+#define _MEMFUN_GROWTH_POLICY_DEFAULT  MEMFUN_GROWTH_GEOMETRIC(12)
 
 #ifndef MEMFUN_MALLOC_DIRTY
 #define MEMFUN_MALLOC_DIRTY 1
@@ -42,10 +60,61 @@
 #define MEMFUN_FREE_SECURE 1
 #endif
 
+/* allocation class flags (for memfun_*_flags()):
+ * - MEMFUN_ZERO: memory is zeroed on allocation and growth
+ *   (with calloc(3) or fresh anonymous pages where possible);
+ * - MEMFUN_SENSITIVE: memory is wiped with explicit_bzero(3) on free
+ *   and old memory is wiped if growth moves data (so no copies are left behind).
+ * Plain memfun_alloc_ex(), memfun_realloc*() and memfun_free() derive flags from
+ * MEMFUN_MALLOC_DIRTY, MEMFUN_REALLOC_DIRTY and MEMFUN_FREE_SECURE respectively.
+ */
+#define MEMFUN_ZERO       0x1U
+#define MEMFUN_SENSITIVE  0x2U
+
+#define _MEMFUN_FLAGS_ALLOC    ((MEMFUN_MALLOC_DIRTY) ? MEMFUN_ZERO : 0U)
+#define _MEMFUN_FLAGS_REALLOC  ((MEMFUN_REALLOC_DIRTY) ? MEMFUN_ZERO : 0U)
+#define _MEMFUN_FLAGS_FREE     ((MEMFUN_FREE_SECURE) ? MEMFUN_SENSITIVE : 0U)
+
+/* optional: large allocations (MEMFUN_MMAP_THRESHOLD bytes and more) are backed by anonymous mmap(2):
+ * - they're grown with mremap(2) (no copy) and released with munmap(2);
+ * - fresh pages are zeroed by kernel so MEMFUN_ZERO and MEMFUN_SENSITIVE are no-op for them;
+ * - length passed to memfun_realloc*() and memfun_free() must be either allocated length
+ *   or requested one: both are rounded the same way as on allocation
+ *   (see memfun_alloc_length()) and it's the only way to tell mapping from heap memory;
+ * - MEMFUN_MMAP_HUGEPAGE: advise transparent huge pages for mappings of 2 MiB and more;
+ * - MEMFUN_MMAP_POPULATE: prefault pages of new mappings.
+ * mmap(2) backend suits long-living buffers: short-living ones are faster with heap
+ * (which reuses memory instead of faulting in fresh pages each time).
+ * MEMFUN_MMAP_THRESHOLD = 0 (default) disables mmap(2) backend.
+ */
+#ifndef MEMFUN_MMAP_THRESHOLD
+#define MEMFUN_MMAP_THRESHOLD 0
+#endif
+
+#ifndef MEMFUN_MMAP_HUGEPAGE
+#define MEMFUN_MMAP_HUGEPAGE 0
+#endif
+
+#ifndef MEMFUN_MMAP_POPULATE
+#define MEMFUN_MMAP_POPULATE 0
+#endif
+
+#define _MEMFUN_HUGEPAGE_SIZE  (2 * 1024 * 1024)
+
 #if !(defined(MEMFUN_MALLOC) || defined(MEMFUN_REALLOC) || defined(MEMFUN_FREE))
 #include <stdlib.h>
 #endif
 
+#if MEMFUN_MMAP_THRESHOLD
+#include <sys/mman.h>
+#endif
+
+#ifndef MEMFUN_CALLOC
+#ifndef MEMFUN_MALLOC
+#define MEMFUN_CALLOC(size) calloc(1, size)
+#endif
+#endif
+
 #ifndef MEMFUN_MALLOC
 #define MEMFUN_MALLOC(size) malloc(size)
 #endif
@@ -58,6 +127,110 @@
 #define MEMFUN_FREE(ptr) free(ptr)
 #endif
 
+/* optional: allocation statistics (MEMFUN_STATS = 1)
+ *
+ * Counters are kept per translation unit (no locking, so single-threaded use only):
+ * - allocs, frees: allocations and releases;
+ * - reallocs_inplace, reallocs_moved: growths which kept or moved memory block
+ *   (growth from NULL is counted as allocation);
+ * - bytes_copied: bytes copied due to moved growth (mremap(2) doesn't copy);
+ * - bytes_zeroed: bytes zeroed by memfun and its users (calloc(3) included,
+ *   fresh anonymous pages excluded);
+ * - bytes_live, bytes_peak: currently allocated and maximum allocated bytes.
+ * memfun_stats_get() returns all zeros if statistics are disabled.
+ */
+#ifndef MEMFUN_STATS
+#define MEMFUN_STATS 0
+#endif
+
+typedef struct {
+	size_t allocs, frees;
+	size_t reallocs_inplace, reallocs_moved;
+	size_t bytes_copied, bytes_zeroed;
+	size_t bytes_live, bytes_peak;
+} memfun_stats_t;
+
+#if MEMFUN_STATS
+static memfun_stats_t _memfun_stats;
+#endif
+
+static CC_INLINE
+void memfun_stats_get(memfun_stats_t * stats)
+{
+#if MEMFUN_STATS
+	*stats = _memfun_stats;
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+// "bytes_peak" is reset to "bytes_live"
+static CC_INLINE
+void memfun_stats_reset(void)
+{
+#if MEMFUN_STATS
+	size_t live = _memfun_stats.bytes_live;
+	memset(&_memfun_stats, 0, sizeof(_memfun_stats));
+	_memfun_stats.bytes_live = _memfun_stats.bytes_peak = live;
+#endif
+}
+
+static CC_FORCE_INLINE
+void memfun_stats_zeroed(size_t length)
+{
+#if MEMFUN_STATS
+	_memfun_stats.bytes_zeroed += length;
+#else
+	(void) length;
+#endif
+}
+
+static CC_FORCE_INLINE
+void _memfun_stats_live(size_t _old, size_t _new)
+{
+#if MEMFUN_STATS
+	_memfun_stats.bytes_live += _new;
+	_memfun_stats.bytes_live -= _old;
+	if (_memfun_stats.bytes_peak < _memfun_stats.bytes_live)
+		_memfun_stats.bytes_peak = _memfun_stats.bytes_live;
+#else
+	(void) _old; (void) _new;
+#endif
+}
+
+static CC_FORCE_INLINE
+void _memfun_stats_alloc(size_t length)
+{
+#if MEMFUN_STATS
+	_memfun_stats.allocs++;
+#endif
+	_memfun_stats_live(0, length);
+}
+
+static CC_FORCE_INLINE
+void _memfun_stats_realloc(size_t _old, size_t _new, int moved, size_t copied)
+{
+#if MEMFUN_STATS
+	if (moved)
+		_memfun_stats.reallocs_moved++;
+	else
+		_memfun_stats.reallocs_inplace++;
+	_memfun_stats.bytes_copied += copied;
+#else
+	(void) moved; (void) copied;
+#endif
+	_memfun_stats_live(_old, _new);
+}
+
+static CC_FORCE_INLINE
+void _memfun_stats_free(size_t length)
+{
+#if MEMFUN_STATS
+	_memfun_stats.frees++;
+#endif
+	_memfun_stats_live(length, 0);
+}
+
 #ifdef MEMFUN_PAGE
 static const size_t memfun_page_default
 = ((MEMFUN_PAGE) < _MEMFUN_PAGE_DEFAULT)
@@ -119,6 +292,12 @@ static const unsigned int memfun_growth_factor
 = _MEMFUN_GROWTH_FACTOR_DEFAULT;
 #endif /* MEMFUN_GROWTH_FACTOR */
 
+#ifdef MEMFUN_GROWTH_POLICY
+#define MEMFUN_GROWTH_DEFAULT  (MEMFUN_GROWTH_POLICY)
+#else /* ! MEMFUN_GROWTH_POLICY */
+#define MEMFUN_GROWTH_DEFAULT  _MEMFUN_GROWTH_POLICY_DEFAULT
+#endif /* MEMFUN_GROWTH_POLICY */
+
 // n2d = next 2' degree
 
 #define _MEMFUN_N2D_DUMB(x) \
@@ -198,6 +377,92 @@ size_t memfun_calc_growth_ex(size_t item_size, unsigned char growth_factor)
 	return memfun_block_size();
 }
 
+static CC_FORCE_INLINE
+int memfun_is_mmap(size_t length)
+{
+#if MEMFUN_MMAP_THRESHOLD
+	return (length >= (MEMFUN_MMAP_THRESHOLD));
+#else
+	(void) length;
+	return 0;
+#endif
+}
+
+#if MEMFUN_MMAP_THRESHOLD
+
+// 0 on overflow
+static CC_INLINE
+size_t _memfun_mmap_length(size_t length)
+{
+	size_t page = memfun_page_size();
+	size_t result = (length + (page - 1)) & ~(page - 1);
+	return (result < length) ? 0 : result;
+}
+
+static
+void _memfun_mmap_advise(void * ptr, size_t length)
+{
+#if MEMFUN_MMAP_HUGEPAGE && defined(MADV_HUGEPAGE)
+	if (length >= _MEMFUN_HUGEPAGE_SIZE)
+		(void) madvise(ptr, length, MADV_HUGEPAGE);
+#else
+	(void) ptr;
+	(void) length;
+#endif
+}
+
+static
+void * _memfun_mmap(size_t length)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if MEMFUN_MMAP_POPULATE && defined(MAP_POPULATE)
+	flags |= MAP_POPULATE;
+#endif
+
+	void * ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (ptr == MAP_FAILED) return NULL;
+
+	_memfun_mmap_advise(ptr, length);
+	return ptr;
+}
+
+// both lengths are "mmap" ones; returns NULL on failure
+static
+void * _memfun_mremap(void * ptr, size_t _old, size_t _new)
+{
+#ifdef MREMAP_MAYMOVE
+	void * nptr = mremap(ptr, _old, _new, MREMAP_MAYMOVE);
+	if (nptr == MAP_FAILED) return NULL;
+
+	_memfun_mmap_advise(nptr, _new);
+	return nptr;
+#else
+	void * nptr = _memfun_mmap(_new);
+	if (!nptr) return NULL;
+
+	(void) memcpy(nptr, ptr, _old);
+	(void) munmap(ptr, _old);
+	return nptr;
+#endif
+}
+
+#endif /* MEMFUN_MMAP_THRESHOLD */
+
+// length which is actually allocated for "length" (0 on overflow)
+static CC_INLINE
+size_t memfun_alloc_length(size_t length)
+{
+	size_t len = memfun_block_align(length);
+	if (len < length) return 0;
+
+#if MEMFUN_MMAP_THRESHOLD
+	if (memfun_is_mmap(len))
+		len = _memfun_mmap_length(len);
+#endif
+
+	return len;
+}
+
 static
 int memfun_want_realloc_raw(size_t length, size_t extend, size_t * new_length)
 {
@@ -235,23 +500,89 @@ int memfun_want_realloc(size_t length, size_t extend, size_t * new_length)
 	return 1;
 }
 
+// returns new length for "length" extended by at least "extend" or 0 (overflow)
 static
-void * memfun_alloc_ex(size_t * length)
+size_t memfun_growth_calc(size_t length, size_t extend, unsigned int policy)
+{
+	size_t want = 0;
+	if (!memfun_want_realloc_raw(length, extend, &want))
+		return 0;
+
+	unsigned int kind = policy & _MEMFUN_GROWTH_KIND_MASK;
+	if (kind == MEMFUN_GROWTH_GEOMETRIC(0)) {
+		size_t x8 = policy & _MEMFUN_GROWTH_X8_MASK, geo = 0;
+		// too large length - fallback to block growth
+		if ((x8 > 8) && umull(length, x8, &geo)) {
+			geo >>= 3;
+			if (geo > want) want = geo;
+		}
+	}
+
+	size_t result = memfun_block_align(want);
+	return (result < want) ? 0 : result;
+}
+
+// wipe memory (and don't let compiler to optimize it out)
+static
+void memfun_wipe(void * ptr, size_t length)
+{
+	if ((!ptr) || (!length)) return;
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 25)))
+	explicit_bzero(ptr, length);
+#else
+	(void) memset(ptr, 0, length);
+	__asm__ __volatile__ ("" : : "r" (ptr) : "memory");
+#endif
+}
+
+static
+void * memfun_alloc_flags(size_t * length, unsigned int flags)
 {
 	if (!length) return NULL;
 
-	size_t len = memfun_block_align(*length);
-	void * ptr = (MEMFUN_MALLOC(len));
-	if (!ptr) return NULL;
+	size_t len = memfun_alloc_length(*length);
+	if ((!len) && (*length)) return NULL;
+
+#if MEMFUN_MMAP_THRESHOLD
+	// fresh pages are zeroed by kernel
+	if (memfun_is_mmap(len)) {
+		void * ptr = _memfun_mmap(len);
+		if (!ptr) return NULL;
 
-#if MEMFUN_MALLOC_DIRTY
-	if (len) memset(ptr, 0, len);
+		_memfun_stats_alloc(len);
+		*length = len;
+		return ptr;
+	}
 #endif
 
+	void * ptr;
+	if (flags & MEMFUN_ZERO) {
+#ifdef MEMFUN_CALLOC
+		ptr = (MEMFUN_CALLOC(len));
+		if (!ptr) return NULL;
+#else
+		ptr = (MEMFUN_MALLOC(len));
+		if (!ptr) return NULL;
+		if (len) memset(ptr, 0, len);
+#endif
+		memfun_stats_zeroed(len);
+	} else {
+		ptr = (MEMFUN_MALLOC(len));
+		if (!ptr) return NULL;
+	}
+
+	_memfun_stats_alloc(len);
 	*length = len;
 	return ptr;
 }
 
+static CC_FORCE_INLINE
+void * memfun_alloc_ex(size_t * length)
+{
+	return memfun_alloc_flags(length, _MEMFUN_FLAGS_ALLOC);
+}
+
 static CC_FORCE_INLINE
 void * memfun_alloc(size_t length)
 {
@@ -277,18 +608,74 @@ void * memfun_ptr_offset_ex(void * ptr, size_t item_size, size_t item_count)
 	return memfun_ptr_offset(ptr, _off);
 }
 
+// returns NULL on failure (and "ptr" remains valid);
+// "_new" should be allocated length (i.e. result of memfun_alloc_length())
 static
-void * _memfun_realloc(void * ptr, size_t _old, size_t _new)
+void * _memfun_realloc(void * ptr, size_t _old, size_t _new, unsigned int flags)
 {
-	void * nptr = (MEMFUN_REALLOC(ptr, _new));
-	if (!nptr) return ptr;
+	void * nptr;
+
+	// classify (and copy) same way as on allocation
+	if (ptr) _old = memfun_alloc_length(_old);
+
+#if MEMFUN_MMAP_THRESHOLD
+	// fresh pages are zeroed by kernel
+	if (memfun_is_mmap(_new)) {
+		if (!ptr) {
+			nptr = _memfun_mmap(_new);
+			if (nptr) _memfun_stats_alloc(_new);
+			return nptr;
+		}
+
+		if (memfun_is_mmap(_old)) {
+			nptr = _memfun_mremap(ptr, _old, _new);
+#ifdef MREMAP_MAYMOVE
+			if (nptr) _memfun_stats_realloc(_old, _new, (nptr != ptr), 0);
+#else
+			if (nptr) _memfun_stats_realloc(_old, _new, 1, _old);
+#endif
+			return nptr;
+		}
+
+		// heap -> mmap
+		nptr = _memfun_mmap(_new);
+		if (!nptr) return NULL;
+
+		(void) memcpy(nptr, ptr, _old);
+		if (flags & MEMFUN_SENSITIVE)
+			memfun_wipe(ptr, _old);
+		(void) MEMFUN_FREE(ptr);
+		_memfun_stats_realloc(_old, _new, 1, _old);
+		return nptr;
+	}
+#endif
 
-#if MEMFUN_REALLOC_DIRTY
-	if (_new > _old) {
+	if (ptr && (flags & MEMFUN_SENSITIVE)) {
+		// realloc(3) may move data and leave old copy as is
+		nptr = (MEMFUN_MALLOC(_new));
+		if (!nptr) return NULL;
+
+		(void) memcpy(nptr, ptr, _old);
+		memfun_wipe(ptr, _old);
+		(void) MEMFUN_FREE(ptr);
+	} else {
+		nptr = (MEMFUN_REALLOC(ptr, _new));
+		if (!nptr) return NULL;
+	}
+
+	// realloc(3) is assumed to copy data if it moves block
+	if (ptr)
+		_memfun_stats_realloc(_old, _new, (nptr != ptr), (nptr != ptr) ? _old : 0);
+	else
+		_memfun_stats_alloc(_new);
+
+	if ((flags & MEMFUN_ZERO) && (_new > _old)) {
 		void * dirty = memfun_ptr_offset(nptr, _old);
-		if (dirty) memset(dirty, 0, _new - _old);
+		if (dirty) {
+			memset(dirty, 0, _new - _old);
+			memfun_stats_zeroed(_new - _old);
+		}
 	}
-#endif
 
 	return nptr;
 }
@@ -303,9 +690,37 @@ void * memfun_realloc_ex(void * ptr, size_t * length, size_t extend)
 	if (!memfun_want_realloc(_old, extend, &_new))
 		return ptr;
 
+	_new = memfun_alloc_length(_new);
+	if (!_new) return ptr;
+
+	void * nptr = _memfun_realloc(ptr, _old, _new, _MEMFUN_FLAGS_REALLOC);
+	if (!nptr) return ptr;
+
+	*length = _new;
+	return nptr;
+}
+
+// "length" is (exact) allocated length of "ptr";
+// it's left unchanged if reallocation is not possible
+static
+void * memfun_realloc_flags(void * ptr, size_t * length, size_t extend, unsigned int policy, unsigned int flags)
+{
+	if (!length) return ptr;
+
+	size_t _new = memfun_alloc_length(memfun_growth_calc(*length, extend, policy));
+	if (_new <= *length) return ptr;
+
+	void * nptr = _memfun_realloc(ptr, *length, _new, flags);
+	if (!nptr) return ptr;
+
 	*length = _new;
+	return nptr;
+}
 
-	return _memfun_realloc(ptr, _old, _new);
+static CC_FORCE_INLINE
+void * memfun_realloc_policy(void * ptr, size_t * length, size_t extend, unsigned int policy)
+{
+	return memfun_realloc_flags(ptr, length, extend, policy, _MEMFUN_FLAGS_REALLOC);
 }
 
 static CC_FORCE_INLINE
@@ -315,18 +730,36 @@ void * memfun_realloc(void * ptr, size_t length, size_t extend)
 	return memfun_realloc_ex(ptr, &old, extend);
 }
 
+// "length" should be allocated or requested length (see notes about MEMFUN_MMAP_THRESHOLD)
 static
-void memfun_free(void * ptr, size_t length)
+void memfun_free_flags(void * ptr, size_t length, unsigned int flags)
 {
 	if (!ptr) return;
 
-#if MEMFUN_FREE_SECURE
-	if (length) memset(ptr, 0, length);
+#if MEMFUN_MMAP_THRESHOLD
+	// pages are zeroed by kernel before reuse
+	size_t len = memfun_alloc_length(length);
+	if (memfun_is_mmap(len)) {
+		(void) munmap(ptr, len);
+		_memfun_stats_free(len);
+		return;
+	}
 #endif
 
+	if (flags & MEMFUN_SENSITIVE)
+		memfun_wipe(ptr, length);
+
+	_memfun_stats_free(length);
+
 	(void) MEMFUN_FREE(ptr);
 }
 
+static CC_FORCE_INLINE
+void memfun_free(void * ptr, size_t length)
+{
+	memfun_free_flags(ptr, length, _MEMFUN_FLAGS_FREE);
+}
+
 #include "ext-c-end.h"
 
 #endif /* HEADER_INCLUDED_MEMFUN */
@@ -44,6 +44,13 @@ T * memfun_t_realloc_ex(T * ptr, size_t * length, size_t extend)
 	return (T *) memfun_realloc_ex(ptr, length, extend);
 }
 
+template<typename T = void>
+CC_FORCE_INLINE
+T * memfun_t_realloc_policy(T * ptr, size_t * length, size_t extend, unsigned int policy)
+{
+	return (T *) memfun_realloc_policy(ptr, length, extend, policy);
+}
+
 template<typename T = void>
 CC_FORCE_INLINE
 T * memfun_t_realloc(T * ptr, size_t length, size_t extend)
@@ -58,4 +65,30 @@ void memfun_t_free(T * ptr, size_t length)
 	memfun_free(ptr, length);
 }
 
+// allocator for containers;
+// "flags" is set of MEMFUN_ZERO and MEMFUN_SENSITIVE
+template<unsigned int flags = 0>
+struct memfun_allocator_t {
+
+	static CC_INLINE
+	void * alloc_ex(size_t * length) {
+		return memfun_alloc_flags(length, flags);
+	}
+
+	static CC_INLINE
+	void * realloc_policy(void * ptr, size_t * length, size_t extend, unsigned int policy) {
+		return memfun_realloc_flags(ptr, length, extend, policy, flags);
+	}
+
+	static CC_INLINE
+	void free(void * ptr, size_t length) {
+		memfun_free_flags(ptr, length, flags);
+	}
+
+};
+
+// default allocator for containers:
+// containers initialize memory they use, so it's neither zeroed nor wiped
+typedef memfun_allocator_t<> memfun_allocator;
+
 #endif /* HEADER_INCLUDED_MEMFUN_HH */
@@ -0,0 +1,39 @@
+/* monotime: monotonic clock in nanoseconds
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_MONOTIME
+#define HEADER_INCLUDED_MONOTIME 1
+
+#include "ext-c-begin.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#include "cc-inline.h"
+
+#define MONOTIME_NSEC_PER_USEC  1000ULL
+#define MONOTIME_NSEC_PER_MSEC  1000000ULL
+#define MONOTIME_NSEC_PER_SEC   1000000000ULL
+
+static CC_INLINE
+uint64_t monotime_ns(void)
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+
+	return ((uint64_t) ts.tv_sec * MONOTIME_NSEC_PER_SEC) + (uint64_t) ts.tv_nsec;
+}
+
+static CC_INLINE
+uint64_t monotime_us(void)
+{
+	return monotime_ns() / MONOTIME_NSEC_PER_USEC;
+}
+
+#include "ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_MONOTIME */
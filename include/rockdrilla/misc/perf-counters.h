@@ -0,0 +1,113 @@
+/* perf-counters: count hardware/software events of calling thread
+ *
+ * Counters are opened with perf_event_open(2) one by one, so unsupported
+ * (i.e. inside VM) or forbidden counter doesn't disable the others.
+ * If kernel profiling is not permitted (see /proc/sys/kernel/perf_event_paranoid)
+ * then counter is reopened with "exclude_kernel".
+ *
+ * Child processes are not counted (no "inherit") and descriptors are
+ * closed on exec(3).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_PERF_COUNTERS
+#define HEADER_INCLUDED_PERF_COUNTERS 1
+
+#include "ext-c-begin.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+enum {
+	PERF_COUNTER_CYCLES = 0,
+	PERF_COUNTER_INSTRUCTIONS,
+	PERF_COUNTER_CACHE_MISSES,
+	PERF_COUNTER_PAGE_FAULTS,
+	PERF_COUNTER_COUNT
+};
+
+static const char * const perf_counter_name[PERF_COUNTER_COUNT] = {
+	"cycles", "instructions", "cache_misses", "page_faults",
+};
+
+typedef struct {
+	int fd[PERF_COUNTER_COUNT];
+	// counter doesn't include kernel
+	uint8_t user_only[PERF_COUNTER_COUNT];
+} perf_counters;
+
+static
+int _perf_counter_open(uint32_t type, uint64_t config, int exclude_kernel)
+{
+	struct perf_event_attr attr;
+	(void) memset(&attr, 0, sizeof(attr));
+
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = exclude_kernel;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// returns number of opened counters
+static
+int perf_counters_open(perf_counters * p)
+{
+	static const struct {
+		uint32_t type;
+		uint64_t config;
+	} event[PERF_COUNTER_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	};
+
+	int i, n = 0;
+	for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+		p->user_only[i] = 0;
+		p->fd[i] = _perf_counter_open(event[i].type, event[i].config, 0);
+		if ((p->fd[i] < 0) && ((errno == EACCES) || (errno == EPERM))) {
+			p->user_only[i] = 1;
+			p->fd[i] = _perf_counter_open(event[i].type, event[i].config, 1);
+		}
+		if (p->fd[i] >= 0) n++;
+	}
+
+	return n;
+}
+
+static
+void perf_counters_close(perf_counters * p)
+{
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (p->fd[i] < 0) continue;
+		(void) close(p->fd[i]);
+		p->fd[i] = -1;
+	}
+}
+
+// unavailable counters are read as zero
+static
+void perf_counters_read(const perf_counters * p, uint64_t value[PERF_COUNTER_COUNT])
+{
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		value[i] = 0;
+		if (p->fd[i] < 0) continue;
+		if (read(p->fd[i], &value[i], sizeof(value[i])) != sizeof(value[i]))
+			value[i] = 0;
+	}
+}
+
+#include "ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_PERF_COUNTERS */
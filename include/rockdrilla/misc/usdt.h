@@ -0,0 +1,101 @@
+/* usdt: user-level statically defined tracing probes
+ *
+ * Probe is single "nop" instruction in code and record in ELF note section
+ * ".note.stapsdt" which is understood by bpftrace, perf, systemtap, etc.:
+ *   bpftrace -e 'usdt:./xvp:xvp:reap { printf("%d %d\n", arg0, arg2); }'
+ *   perf buildid-cache --add ./xvp && perf list sdt_xvp:*
+ *
+ * <sys/sdt.h> (systemtap-sdt-dev) is used if it's available,
+ * otherwise bundled compatible implementation is used (x86-64 and aarch64 only).
+ * Define USDT_DISABLE to drop probes completely.
+ *
+ * Arguments are passed as signed 64-bit values.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_USDT
+#define HEADER_INCLUDED_USDT 1
+
+#include <stdint.h>
+
+#if defined(USDT_DISABLE)
+
+#define _USDT_PROBE_NONE  do { } while (0)
+
+#define USDT_PROBE0(provider, name)  _USDT_PROBE_NONE
+#define USDT_PROBE1(provider, name, a1)  _USDT_PROBE_NONE
+#define USDT_PROBE2(provider, name, a1, a2)  _USDT_PROBE_NONE
+#define USDT_PROBE3(provider, name, a1, a2, a3)  _USDT_PROBE_NONE
+
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define USDT_PROBE0(provider, name)  DTRACE_PROBE(provider, name)
+#define USDT_PROBE1(provider, name, a1)  DTRACE_PROBE1(provider, name, (int64_t) (a1))
+#define USDT_PROBE2(provider, name, a1, a2)  DTRACE_PROBE2(provider, name, (int64_t) (a1), (int64_t) (a2))
+#define USDT_PROBE3(provider, name, a1, a2, a3)  DTRACE_PROBE3(provider, name, (int64_t) (a1), (int64_t) (a2), (int64_t) (a3))
+
+#elif defined(__x86_64__) || defined(__aarch64__)
+
+/* refs:
+ * - [1] https://sourceware.org/systemtap/wiki/UserSpaceProbeImplementation
+ */
+
+#define _USDT_ARG(n)  "-8@%" #n
+
+#define _USDT_PROBE(provider, name, args, ...) \
+	__asm__ __volatile__ ( \
+		"990: nop\n" \
+		".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+		".balign 4\n" \
+		".4byte 992f-991f, 994f-993f, 3\n" \
+		"991: .asciz \"stapsdt\"\n" \
+		"992: .balign 4\n" \
+		"993: .8byte 990b\n" \
+		".8byte _.stapsdt.base\n" \
+		".8byte 0\n" \
+		".asciz \"" #provider "\"\n" \
+		".asciz \"" #name "\"\n" \
+		".asciz \"" args "\"\n" \
+		"994: .balign 4\n" \
+		".popsection\n" \
+		".ifndef _.stapsdt.base\n" \
+		".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+		".weak _.stapsdt.base\n" \
+		".hidden _.stapsdt.base\n" \
+		"_.stapsdt.base: .space 1\n" \
+		".size _.stapsdt.base, 1\n" \
+		".popsection\n" \
+		".endif\n" \
+		:: __VA_ARGS__ \
+	)
+
+#define _USDT_OP(a)  "nor" ((int64_t) (a))
+
+#define USDT_PROBE0(provider, name) \
+	_USDT_PROBE(provider, name, "")
+#define USDT_PROBE1(provider, name, a1) \
+	_USDT_PROBE(provider, name, _USDT_ARG(0), \
+		_USDT_OP(a1))
+#define USDT_PROBE2(provider, name, a1, a2) \
+	_USDT_PROBE(provider, name, _USDT_ARG(0) " " _USDT_ARG(1), \
+		_USDT_OP(a1), _USDT_OP(a2))
+#define USDT_PROBE3(provider, name, a1, a2, a3) \
+	_USDT_PROBE(provider, name, _USDT_ARG(0) " " _USDT_ARG(1) " " _USDT_ARG(2), \
+		_USDT_OP(a1), _USDT_OP(a2), _USDT_OP(a3))
+
+#else
+
+#define _USDT_PROBE_NONE  do { } while (0)
+
+#define USDT_PROBE0(provider, name)  _USDT_PROBE_NONE
+#define USDT_PROBE1(provider, name, a1)  _USDT_PROBE_NONE
+#define USDT_PROBE2(provider, name, a1, a2)  _USDT_PROBE_NONE
+#define USDT_PROBE3(provider, name, a1, a2, a3)  _USDT_PROBE_NONE
+
+#endif
+
+#endif /* HEADER_INCLUDED_USDT */
@@ -49,6 +49,9 @@ _DEGREE2_NEXT_FUNC(,   unsigned int)
 _DEGREE2_NEXT_FUNC(l,  unsigned long)
 _DEGREE2_NEXT_FUNC(ll, unsigned long long)
 
+typedef char _degree2_check32[(DEGREE2_NEXT_MACRO32(0x80000001U) == 0) ? 1 : -1];
+typedef char _degree2_check64[(DEGREE2_NEXT_MACRO64(0x8000000000000001ULL) == 0) ? 1 : -1];
+
 #include "../misc/ext-c-end.h"
 
 #endif /* HEADER_INCLUDED_NUM_DEGREE2 */
@@ -19,6 +19,17 @@
 #define GETMSB_MACRO32(v)  ( (((v) & UINT_MAX)   == 0) ? 0 : _GETMSB32(v) )
 #define GETMSB_MACRO64(v)  ( (((v) & ULLONG_MAX) == 0) ? 0 : _GETMSB64(v) )
 
+#if _SETLOWER_HAVE_BUILTIN
+
+#define _GETMSB_DEFINE_FUNC(n, t) \
+	static CC_INLINE \
+	int getmsb ## n (t v) { \
+		if (v == 0) return 0; \
+		return (int) (sizeof(t) * CHAR_BIT) - __builtin_clz ## n (v); \
+	}
+
+#else /* ! _SETLOWER_HAVE_BUILTIN */
+
 #define _GETMSB_DEFINE_FUNC(n, t) \
 	static CC_INLINE \
 	int getmsb ## n (t v) { \
@@ -26,10 +37,15 @@
 		return popcnt ## n (set_lower ## n (v)); \
 	}
 
+#endif /* _SETLOWER_HAVE_BUILTIN */
+
 _GETMSB_DEFINE_FUNC(,   unsigned int)
 _GETMSB_DEFINE_FUNC(l,  unsigned long)
 _GETMSB_DEFINE_FUNC(ll, unsigned long long)
 
+typedef char _getmsb_check32[(GETMSB_MACRO32(0x80000001U) == 32) ? 1 : -1];
+typedef char _getmsb_check64[(GETMSB_MACRO64(0x8000000000000001ULL) == 64) ? 1 : -1];
+
 #include "../misc/ext-c-end.h"
 
 #endif /* HEADER_INCLUDED_NUM_GETMSB */
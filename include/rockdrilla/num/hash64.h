@@ -0,0 +1,69 @@
+/* hash64: fast non-cryptographic hash of byte strings
+ *
+ * Input is consumed in 8-byte words (multiply-rotate), result is finalized
+ * with "fmix64" of MurmurHash3 [1] so both halves of hash are usable
+ * (i.e. lower bits for table position and upper bits as fingerprint).
+ *
+ * Nota bene: hash is NOT resistant to crafted input (hash flooding).
+ *
+ * refs:
+ * - [1] https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_NUM_HASH64
+#define HEADER_INCLUDED_NUM_HASH64 1
+
+#include "../misc/ext-c-begin.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../misc/cc-inline.h"
+
+#define _HASH64_K  0x9e3779b97f4a7c15ULL
+
+static CC_FORCE_INLINE
+uint64_t hash64_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static CC_FORCE_INLINE
+uint64_t _hash64_step(uint64_t h, uint64_t w)
+{
+	h = (h ^ w) * _HASH64_K;
+	return (h << 31) | (h >> 33);
+}
+
+static CC_INLINE
+uint64_t hash64(const void * ptr, size_t length)
+{
+	const unsigned char * p = (const unsigned char *) ptr;
+	uint64_t h = (uint64_t) length * _HASH64_K, w;
+
+	for (; length >= sizeof(w); p += sizeof(w), length -= sizeof(w)) {
+		(void) memcpy(&w, p, sizeof(w));
+		h = _hash64_step(h, w);
+	}
+
+	if (length) {
+		w = 0;
+		(void) memcpy(&w, p, length);
+		h = _hash64_step(h, w);
+	}
+
+	return hash64_mix(h);
+}
+
+#include "../misc/ext-c-end.h"
+
+#endif /* HEADER_INCLUDED_NUM_HASH64 */
@@ -1,13 +1,16 @@
 /* popcnt: simple wrapper
  *
  * - if using "builtins" is desired (POPCNT_NO_BUILTIN is not defined):
- *   - if compiler can't optimize current call in build time:
- *     - if "popcnt" instruction is supported by CPU in runtime [determined only once]:
- * 		 - then instruction is to be "called".
- *     - if "popcnt" instruction isn't supported by CPU in runtime:
- *       - "bithacks" function is called (inspired by [1]).
  *   - if compiler can optimize current call in build time:
  *     - nothing is called (you're getting intermediate value somewhere).
+ *   - if "popcnt" instruction is enabled in build time (e.g. "-mpopcnt") or CPU always has one (aarch64):
+ *     - builtin is inlined.
+ *   - otherwise (x86):
+ *     - implementation is selected once (see misc/cpufeat.h):
+ *       - if "popcnt" instruction is supported by CPU in runtime:
+ *         - function with instruction is called.
+ *       - if "popcnt" instruction isn't supported by CPU in runtime:
+ *         - "bithacks" function is called (inspired by [1]).
  * - if using "builtins" isn't desired (POPCNT_NO_BUILTIN is defined):
  *   - "bithacks" function is called (inspired by [1]).
  *
@@ -33,22 +36,13 @@
 #include <limits.h>
 
 #include "../misc/cc-inline.h"
+#include "../misc/cpufeat.h"
 
-#ifdef __has_builtin
-  #if __has_builtin(__builtin_cpu_init)
-  #if __has_builtin(__builtin_cpu_supports)
-    #ifndef _POPCNT_HAVE_BUILTIN
-    #define _POPCNT_HAVE_BUILTIN 1
-    #endif
-  #endif /* __has_builtin(__builtin_cpu_supports) */
-  #endif /* __has_builtin(__builtin_cpu_init) */
-#endif /* __has_builtin */
-#ifndef _POPCNT_HAVE_BUILTIN
-#define _POPCNT_HAVE_BUILTIN 0
-#endif
 #ifndef POPCNT_NO_BUILTIN
-  #if _POPCNT_HAVE_BUILTIN
+  #if defined(__POPCNT__) || defined(__aarch64__)
     #define _POPCNT_USE_BUILTIN 1
+  #elif defined(_CPUFEAT_X86) && _CPUFEAT_HAVE_CPU_SUPPORTS
+    #define _POPCNT_USE_DISPATCH 1
   #endif
 #endif /* ! POPCNT_NO_BUILTIN */
 
@@ -67,47 +61,57 @@ _POPCNT_DECLARE_BITHACKS(ll, unsigned long long);
 
 #if _POPCNT_USE_BUILTIN
 
-#define _POPCNT_BUILTIN_NONE  0
-#define _POPCNT_BUILTIN_OK    1
-#define _POPCNT_BUILTIN_NACK  2
-
-static int _popcnt_builtin = _POPCNT_BUILTIN_NONE;
-
-static CC_FORCE_INLINE
-int _popcnt_cpu_supports(void)
-{
-	/* ref:
-	 * - https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
-	 * - https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
-	 */
-	__builtin_cpu_init();
-	return (__builtin_cpu_supports("popcnt"))
-		? _POPCNT_BUILTIN_OK
-		: _POPCNT_BUILTIN_NACK;
-}
-
-#define _POPCNT_TRY_BUILTIN(f) \
-	{ while (1) { \
-		if (_popcnt_builtin == _POPCNT_BUILTIN_OK) \
-			return f(x); \
-		if (_popcnt_builtin == _POPCNT_BUILTIN_NACK) \
-			break; \
-		_popcnt_builtin = _popcnt_cpu_supports(); \
-	} }
-
-#else /* ! _POPCNT_USE_BUILTIN */
-
-#define _POPCNT_TRY_BUILTIN(f) {}
+#define _POPCNT_DEFINE_FUNC(n, t) \
+	static CC_INLINE \
+	int popcnt ## n (t x) { \
+		return __builtin_popcount ## n (x); \
+	}
 
-#endif /* _POPCNT_USE_BUILTIN */
+#elif _POPCNT_USE_DISPATCH
+
+/* ref:
+ * - https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
+ * - https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+ */
+
+#define _POPCNT_DEFINE_FUNC(n, t) \
+	static CPUFEAT_TARGET("popcnt") \
+	int _popcnt ## n ## _insn (t x) { \
+		return __builtin_popcount ## n (x); \
+	} \
+	\
+	static \
+	int _popcnt ## n ## _soft (t x) { \
+		return _POPCNT_BITHACKS(n) (x); \
+	} \
+	\
+	static \
+	int (* _popcnt ## n ## _resolve (void)) (t) { \
+		return (cpufeat() & CPUFEAT_POPCNT) \
+			? _popcnt ## n ## _insn \
+			: _popcnt ## n ## _soft; \
+	} \
+	\
+	CPUFEAT_DISPATCH(_popcnt ## n ## _any, int, (t x), _popcnt ## n ## _resolve) \
+	CPUFEAT_DISPATCH_STUB(_popcnt ## n ## _any, int, (t x), (x), _popcnt ## n ## _resolve) \
+	\
+	static CC_INLINE \
+	int popcnt ## n (t x) { \
+		if (__builtin_constant_p(x)) \
+			return _POPCNT_BITHACKS(n) (x); \
+		return _popcnt ## n ## _any (x); \
+	}
+
+#else /* ! _POPCNT_USE_BUILTIN && ! _POPCNT_USE_DISPATCH */
 
 #define _POPCNT_DEFINE_FUNC(n, t) \
 	static CC_INLINE \
 	int popcnt ## n (t x) { \
-		_POPCNT_TRY_BUILTIN(__builtin_popcount ## n) \
 		return _POPCNT_BITHACKS(n) (x); \
 	}
 
+#endif /* _POPCNT_USE_BUILTIN */
+
 _POPCNT_DEFINE_FUNC(,   unsigned int)
 _POPCNT_DEFINE_FUNC(l,  unsigned long)
 _POPCNT_DEFINE_FUNC(ll, unsigned long long)
@@ -27,7 +27,7 @@
 
 #define _ROUNDBY_DEFINE_FUNC(n, t) \
 	static CC_INLINE \
-	int roundby ## n (t value, t align) { \
+	t roundby ## n (t value, t align) { \
 		if (align < 2) return value; \
 		t r, x; \
 		r = (popcnt ## n (align) == 1) ? (value & (align - 1)) : (value % align); \
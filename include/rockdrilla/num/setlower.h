@@ -1,4 +1,7 @@
 /* set lower: set all bits to 1 starting from most significant set bit
+ *
+ * Functions use "count leading zeros" builtin (if available): it's single instruction
+ * in baseline ISA of x86 ("bsr") and aarch64 ("clz"), so no runtime selection is needed.
  *
  * SPDX-License-Identifier: Apache-2.0
  * (c) 2022-2023, Konstantin Demin
@@ -14,14 +17,15 @@
 #include "../misc/cc-inline.h"
 #include "../misc/dumb-recurse.h"
 
-#define _SETLOWER_a(v)     ( (v) | ((v) - 1) | ((v) >> 1) )
-#define _SETLOWER_b(v)     ( (v) << 1 )
-#define _SETLOWER_x(a, b)  ( ((a) | (b)) >> 1 )
+// "a" is "v" or'ed with itself shifted by 1..k bits, "x" extends it to 1..k+1;
+// nothing is shifted left so most significant bit of type is kept
+#define _SETLOWER_a(v)     ( (v) | ((v) >> 1) | ((v) >> 2) )
+#define _SETLOWER_x(a, v)  ( ((a) >> 1) | (v) )
 
 // 32 - 3 = 29
-#define __SETLOWER32(v)  DUMB_RECURSE_29(_SETLOWER_x, _SETLOWER_a(v), _SETLOWER_b(v))
+#define __SETLOWER32(v)  DUMB_RECURSE_29(_SETLOWER_x, _SETLOWER_a(v), (v))
 // 64 - 3 = 61
-#define __SETLOWER64(v)  DUMB_RECURSE_61(_SETLOWER_x, _SETLOWER_a(v), _SETLOWER_b(v))
+#define __SETLOWER64(v)  DUMB_RECURSE_61(_SETLOWER_x, _SETLOWER_a(v), (v))
 
 #define _SETLOWER32(v)  (__SETLOWER32((v) & UINT_MAX))
 #define _SETLOWER64(v)  (__SETLOWER64((v) & ULLONG_MAX))
@@ -29,22 +33,44 @@
 #define SET_LOWER_MACRO32(v)  ( (((v) & UINT_MAX)   == 0) ? 0 : _SETLOWER32(v) )
 #define SET_LOWER_MACRO64(v)  ( (((v) & ULLONG_MAX) == 0) ? 0 : _SETLOWER64(v) )
 
+#ifdef __has_builtin
+  #if __has_builtin(__builtin_clz)
+    #ifndef _SETLOWER_HAVE_BUILTIN
+    #define _SETLOWER_HAVE_BUILTIN 1
+    #endif
+  #endif /* __has_builtin(__builtin_clz) */
+#endif /* __has_builtin */
+
+#if _SETLOWER_HAVE_BUILTIN
+
 #define _SETLOWER_DEFINE_FUNC(n, t) \
 	static CC_INLINE \
 	t set_lower ## n (t v) { \
 		if (v == 0) return 0; \
-		t a = v | (v - 1) | (v >> 1); \
-		t b = v << 1; \
-		for (unsigned int i = 0; i < ((sizeof(t) * CHAR_BIT) - 3); i++) { \
-			a = (a | b) >> 1; \
+		return ((t) ~((t) 0)) >> __builtin_clz ## n (v); \
+	}
+
+#else /* ! _SETLOWER_HAVE_BUILTIN */
+
+#define _SETLOWER_DEFINE_FUNC(n, t) \
+	static CC_INLINE \
+	t set_lower ## n (t v) { \
+		for (unsigned int i = 1; i < (sizeof(t) * CHAR_BIT); i <<= 1) { \
+			v |= v >> i; \
 		} \
-		return a; \
+		return v; \
 	}
 
+#endif /* _SETLOWER_HAVE_BUILTIN */
+
 _SETLOWER_DEFINE_FUNC(,   unsigned int)
 _SETLOWER_DEFINE_FUNC(l,  unsigned long)
 _SETLOWER_DEFINE_FUNC(ll, unsigned long long)
 
+// most significant bit of type must survive
+typedef char _setlower_check32[(SET_LOWER_MACRO32(0x80000001U) == UINT_MAX) ? 1 : -1];
+typedef char _setlower_check64[(SET_LOWER_MACRO64(0x8000000000000001ULL) == ULLONG_MAX) ? 1 : -1];
+
 #include "../misc/ext-c-end.h"
 
 #endif /* HEADER_INCLUDED_NUM_SETLOWER */
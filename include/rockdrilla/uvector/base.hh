@@ -1,6 +1,8 @@
 /* uvector: dynamic array (c++-like version)
  *
- * - common definitions
+ * - common definitions:
+ *   - base: layout constants (no data members, no virtual methods);
+ *   - iface: generic algorithms for containers (static polymorphism with CRTP)
  *
  * SPDX-License-Identifier: Apache-2.0
  * (c) 2022-2023, Konstantin Demin
@@ -17,12 +19,6 @@ namespace uvector {
 template<typename value_t, typename index_t = size_t, unsigned int growth_factor = 0>
 struct base {
 
-	virtual index_t used(void) const = 0;
-	virtual index_t allocated(void) const = 0;
-
-	virtual index_t append(const value_t * source) = 0;
-	virtual index_t append(const value_t & source) = 0;
-
 	static constexpr int     r_ptr_bits = sizeof(size_t) * CHAR_BIT;
 	static constexpr int     r_idx_bits = sizeof(index_t) * CHAR_BIT;
 	static constexpr index_t r_idx_max  = ~((index_t) 0);
@@ -63,6 +59,104 @@ struct base {
 
 };
 
+/* container "derived_t" provides:
+ *   index_t count(void) const;            - number of items
+ *   item_t  get_view(index_t index) const; - item view by index
+ *     (pointer to item or pointer with length)
+ * and gets generic algorithms which are resolved at compile time
+ * (so container has neither vtable pointer nor extra data members).
+ *
+ * Range-for yields item views as well:
+ *   for (auto v : container) { ... }
+ */
+template<typename derived_t, typename index_t, typename item_t>
+struct iface {
+
+protected:
+
+	CC_FORCE_INLINE
+	const derived_t & self(void) const {
+		return *static_cast<const derived_t *>(this);
+	}
+
+	CC_FORCE_INLINE
+	derived_t & self(void) {
+		return *static_cast<derived_t *>(this);
+	}
+
+public:
+
+	struct iterator {
+		const derived_t * _c;
+		index_t _i;
+
+		CC_INLINE
+		item_t operator * (void) const {
+			return _c->get_view(_i);
+		}
+
+		CC_INLINE
+		iterator & operator ++ (void) {
+			_i++;
+			return *this;
+		}
+
+		CC_INLINE
+		bool operator != (const iterator & other) const {
+			return (_i != other._i);
+		}
+
+		CC_INLINE
+		bool operator == (const iterator & other) const {
+			return (_i == other._i);
+		}
+	};
+
+	CC_INLINE
+	iterator begin(void) const {
+		return { &self(), 0 };
+	}
+
+	CC_INLINE
+	iterator end(void) const {
+		return { &self(), self().count() };
+	}
+
+	CC_INLINE
+	bool empty(void) const {
+		return (self().count() == 0);
+	}
+
+	void walk(void (*visitor)(index_t, item_t)) const {
+		const index_t n = self().count();
+		for (index_t i = 0; i < n; i++) {
+			visitor(i, self().get_view(i));
+		}
+	}
+
+	template<typename T = void>
+	void walk(void (*visitor)(index_t, item_t, T *), T * state) const {
+		const index_t n = self().count();
+		for (index_t i = 0; i < n; i++) {
+			visitor(i, self().get_view(i), state);
+		}
+	}
+
+	void rwalk(void (*visitor)(index_t, item_t)) const {
+		for (index_t i = self().count(); (i--) != 0; ) {
+			visitor(i, self().get_view(i));
+		}
+	}
+
+	template<typename T = void>
+	void rwalk(void (*visitor)(index_t, item_t, T *), T * state) const {
+		for (index_t i = self().count(); (i--) != 0; ) {
+			visitor(i, self().get_view(i), state);
+		}
+	}
+
+};
+
 } /* namespace uvector */
 
 #endif /* HEADER_INCLUDED_UVECTOR_BASE_HH */
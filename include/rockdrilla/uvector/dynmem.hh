@@ -13,8 +13,8 @@
 
 namespace uvector {
 
-template<typename value_t, typename index_t = size_t, unsigned int growth_factor = 0>
-struct dynmem {
+template<typename value_t, typename index_t = size_t, unsigned int growth_factor = 0, unsigned int growth_policy = MEMFUN_GROWTH_DEFAULT, typename allocator_t = memfun_allocator>
+struct dynmem : iface<dynmem<value_t, index_t, growth_factor, growth_policy, allocator_t>, index_t, const value_t *> {
 
 protected:
 
@@ -30,6 +30,8 @@ protected:
 
 	index_t _used = 0, _allocated = 0;
 	value_align_t * _ptr = nullptr;
+	// exact allocated length ("_allocated" is rounded down to whole items)
+	size_t _bytes = 0;
 
 	CC_INLINE
 	void flush_self(void) {
@@ -58,10 +60,12 @@ protected:
 	}
 
 	int _grow_by_bytes(size_t bytes) {
-		size_t _new = _base::offset_of(_allocated);
-		auto nptr = memfun_t_realloc_ex(_ptr, &_new, bytes);
-		if ((!nptr) || (!_new)) return 0;
+		size_t _old = _bytes;
+		size_t _new = _old;
+		auto nptr = (value_align_t *) allocator_t::realloc_policy(_ptr, &_new, bytes, growth_policy);
+		if ((!nptr) || (_new <= _old)) return 0;
 
+		_bytes = _new;
 		size_t _alloc = _new / align_size;
 		_allocated = (_alloc < idx_max) ? _alloc : idx_max;
 
@@ -96,15 +100,22 @@ public:
 		flush_self();
 	}
 
-	template<unsigned int source_growth>
-	dynmem(const dynmem<value_t, index_t, source_growth> & source) {
+	// deep copy (container is left empty on failure)
+	template<unsigned int source_growth, unsigned int source_policy, typename source_allocator>
+	dynmem(const dynmem<value_t, index_t, source_growth, source_policy, source_allocator> & source) {
 		flush_self();
+		copy_from(source);
+	}
 
-		if (!grow_by_count(source.used())) return;
+	dynmem(const dynmem & source) {
+		flush_self();
+		copy_from(source);
+	}
 
-		_used = source.used();
-		if (_used)
-			(void) memcpy(_ptr, source.get(0), _base::offset_of(_used));
+	// move: memory is handed over without allocation, "source" is left empty
+	dynmem(dynmem && source) {
+		flush_self();
+		swap(source);
 	}
 
 	dynmem(index_t reserve_count) {
@@ -112,10 +123,40 @@ public:
 		grow_by_count(reserve_count);
 	}
 
-	dynmem & operator = (const dynmem & other) = default;
+	dynmem & operator = (const dynmem & other) {
+		if (this == &other) return *this;
+
+		free();
+		copy_from(other);
+		return *this;
+	}
+
+	dynmem & operator = (dynmem && other) {
+		if (this == &other) return *this;
+
+		free();
+		swap(other);
+		return *this;
+	}
+
+	void swap(dynmem & other) {
+		index_t u = _used, a = _allocated;
+		value_align_t * p = _ptr;
+		size_t b = _bytes;
+
+		_used = other._used;
+		_allocated = other._allocated;
+		_ptr = other._ptr;
+		_bytes = other._bytes;
+
+		other._used = u;
+		other._allocated = a;
+		other._ptr = p;
+		other._bytes = b;
+	}
 
 	void free(void) {
-		memfun_t_free(_ptr, _base::offset_of(_used));
+		allocator_t::free(_ptr, _bytes);
 		flush_self();
 	}
 
@@ -124,6 +165,11 @@ public:
 		return _used;
 	}
 
+	CC_INLINE
+	index_t count(void) const {
+		return _used;
+	}
+
 	CC_INLINE
 	index_t allocated(void) const {
 		return _allocated;
@@ -135,6 +181,11 @@ public:
 		return ptr_of(index);
 	}
 
+	CC_INLINE
+	const value_t * get_view(index_t index) const {
+		return get(index);
+	}
+
 	bool set(index_t index, const value_t * source) {
 		if (index >= _used) return false;
 
@@ -178,29 +229,79 @@ public:
 		return (_used++);
 	}
 
-	template<unsigned int source_growth>
-	index_t append(const dynmem<value_t, index_t, source_growth> & source, index_t begin, index_t count) {
+	// append "n" items from plain array (single reservation);
+	// returns index of first appended item
+	index_t append_n(const value_t * source, index_t n) {
+		if (!source) return idx_inv;
+		if (!reserve(n)) return idx_inv;
+
+		if (item_size == align_size) {
+			if (n) (void) memcpy(&(_ptr[_used]), source, _base::offset_of(n));
+		} else {
+			for (index_t i = 0; i < n; i++)
+				set_by_ptr(_used + i, &(source[i]));
+		}
+
+		index_t idx = _used;
+		_used += n;
+		return idx;
+	}
+
+	// insert "n" items from plain array at "index" (single reservation);
+	// returns "index" on success
+	index_t insert_n(index_t index, const value_t * source, index_t n) {
+		if (!source) return idx_inv;
+		if (index > _used) return idx_inv;
+		if (!reserve(n)) return idx_inv;
+
+		if (n && (index < _used))
+			(void) memmove(&(_ptr[index + n]), &(_ptr[index]), _base::offset_of(_used - index));
+
+		if (item_size == align_size) {
+			if (n) (void) memcpy(&(_ptr[index]), source, _base::offset_of(n));
+		} else {
+			for (index_t i = 0; i < n; i++)
+				set_by_ptr(index + i, &(source[i]));
+		}
+
+		_used += n;
+		return index;
+	}
+
+	// append items [begin, begin + count) with single memcpy(3);
+	// returns number of appended items (all or nothing)
+	template<unsigned int source_growth, unsigned int source_policy, typename source_allocator>
+	index_t append(const dynmem<value_t, index_t, source_growth, source_policy, source_allocator> & source, index_t begin, index_t count) {
 		if (begin >= source.used()) return 0;
 
-		index_t end = begin + count;
-		if (end > source.used())
+		if (count > (source.used() - begin))
 			count = source.used() - begin;
 
-		index_t i, k = idx_inv;
-		for (i = begin; i < end; i++) {
-			k = append(source.get(i));
-			if (is_inv(k)) break;
-		}
+		if (!count) return 0;
+		if (!reserve(count)) return 0;
 
-		if (is_inv(k)) count = i - begin;
+		// both containers share item layout
+		(void) memcpy(&(_ptr[_used]), source.get(begin), _base::offset_of(count));
+		_used += count;
 		return count;
 	}
 
-	template<unsigned int source_growth>
-	index_t append(const dynmem<value_t, index_t, source_growth> & source) {
+	template<unsigned int source_growth, unsigned int source_policy, typename source_allocator>
+	index_t append(const dynmem<value_t, index_t, source_growth, source_policy, source_allocator> & source) {
 		return append(source, 0, source.used());
 	}
 
+	// container should be empty
+	template<unsigned int source_growth, unsigned int source_policy, typename source_allocator>
+	bool copy_from(const dynmem<value_t, index_t, source_growth, source_policy, source_allocator> & source) {
+		if (!source.used()) return true;
+		if (!grow_by_count(source.used())) return false;
+
+		_used = source.used();
+		(void) memcpy(_ptr, source.get(0), _base::offset_of(_used));
+		return true;
+	}
+
 	int grow_by_bytes(size_t bytes) {
 		if (!bytes) return 0;
 		if (_allocated >= idx_max) return 0;
@@ -216,6 +317,15 @@ public:
 		return _grow_by_count(count);
 	}
 
+	// room for "count" more items
+	bool reserve(index_t count) {
+		index_t room = _allocated - _used;
+		if (room >= count) return true;
+
+		grow_by_count(count - room);
+		return ((_allocated - _used) >= count);
+	}
+
 	int grow_auto(void) {
 		if (_used < _allocated)
 			return 1;
@@ -223,32 +333,6 @@ public:
 		return grow_by_bytes(growth);
 	}
 
-	void walk(void (*visitor)(index_t, const value_t *)) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, ptr_of(i));
-		}
-	}
-
-	template<typename T = void>
-	void walk(void (*visitor)(index_t, const value_t *, T *), T * state) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, ptr_of(i), state);
-		}
-	}
-
-	void rwalk(void (*visitor)(index_t, const value_t *)) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, ptr_of(i));
-		}
-	}
-
-	template<typename T = void>
-	void rwalk(void (*visitor)(index_t, const value_t *, T *), T * state) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, ptr_of(i), state);
-		}
-	}
-
 };
 
 } /* namespace uvector */
@@ -0,0 +1,295 @@
+/* uvector: set of strings (c++-like version)
+ *
+ * - hashset: exact set with open addressing (linear probing):
+ *   - strings are stored in "str_compact" pool (in order of insertion);
+ *   - table slot is 8 bytes (32-bit hash and offset of string in pool),
+ *     so probing touches pool only if hashes are equal (and offsets of pool
+ *     are not touched at all);
+ *   - strings should not contain NUL bytes (pool strings are compared up to
+ *     terminator);
+ *   - memory usage may be limited (approximately: pool may overshoot the limit
+ *     by one growth step).
+ * - bloom: approximate set (split block Bloom filter [1]):
+ *   - fixed amount of memory, no strings are stored;
+ *   - one 32-byte block per string, one bit in each 32-bit word of block
+ *     (so single cache line is touched);
+ *   - false positives are possible, false negatives are not;
+ *   - allocator should return zeroed memory (default one does it with calloc(3)
+ *     or fresh anonymous pages, so filter pages are touched only on demand).
+ *
+ * refs:
+ * - [1] https://github.com/apache/parquet-format/blob/master/BloomFilter.md
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_UVECTOR_HASHSET_HH
+#define HEADER_INCLUDED_UVECTOR_HASHSET_HH 1
+
+#include "str.hh"
+#include "../num/degree2.h"
+#include "../num/hash64.h"
+
+namespace uvector {
+
+template<typename index_t = unsigned int, unsigned int growth_policy = MEMFUN_GROWTH_DEFAULT, typename allocator_t = memfun_allocator>
+struct hashset : iface<hashset<index_t, growth_policy, allocator_t>, index_t, str_view> {
+
+protected:
+
+	using pool_t = str_compact<index_t, growth_policy, allocator_t>;
+
+	// initial number of slots
+	static constexpr size_t slots_min = 64;
+
+	typedef struct {
+		uint32_t hash;
+		// offset of string in pool plus one (zero marks empty slot)
+		uint32_t pos;
+	} slot_t;
+
+	pool_t _pool;
+	slot_t * _slots = nullptr;
+	// number of slots minus one (number of slots is power of 2)
+	size_t _mask = 0;
+	// memory limit (zero means no limit)
+	size_t _limit = 0;
+
+	// both table position and fingerprint are taken from single 32-bit value:
+	// table is rehashed without access to pool
+	static CC_INLINE
+	uint32_t _hash(const char * string, size_t length) {
+		uint64_t h = hash64(string, length);
+		return (uint32_t) (h ^ (h >> 32));
+	}
+
+	CC_INLINE
+	size_t _slots_size(void) const {
+		return (_slots) ? ((_mask + 1) * sizeof(slot_t)) : 0;
+	}
+
+	// returns slot which holds "string" or empty slot where it should be placed
+	slot_t * _lookup(uint32_t hash, const char * string, size_t length) const {
+		for (size_t i = hash & _mask; ; i = (i + 1) & _mask) {
+			slot_t * s = &(_slots[i]);
+			if (!s->pos) return s;
+			if (s->hash != hash) continue;
+
+			// pool string is terminated so strnlen(3) doesn't go beyond pool
+			const char * p = _pool.data() + (s->pos - 1);
+			if (strnlen(p, length + 1) != length) continue;
+			if (memcmp(p, string, length) == 0) return s;
+		}
+	}
+
+	bool _resize(size_t slots) {
+		size_t len = slots * sizeof(slot_t);
+		if (_limit && ((memory() - _slots_size() + len) > _limit)) return false;
+
+		auto nslots = (slot_t *) allocator_t::alloc_ex(&len);
+		if (!nslots) return false;
+		(void) memset(nslots, 0, slots * sizeof(slot_t));
+
+		slot_t * oslots = _slots;
+		size_t oslots_size = _slots_size();
+		size_t omask = _mask;
+
+		_slots = nslots;
+		_mask = slots - 1;
+
+		if (!oslots) return true;
+
+		for (size_t i = 0; i <= omask; i++) {
+			if (!oslots[i].pos) continue;
+
+			size_t k = oslots[i].hash & _mask;
+			while (_slots[k].pos) k = (k + 1) & _mask;
+			_slots[k] = oslots[i];
+		}
+
+		allocator_t::free(oslots, oslots_size);
+		return true;
+	}
+
+public:
+
+	static CC_INLINE
+	bool is_inv(index_t index) {
+		return pool_t::is_inv(index);
+	}
+
+	hashset() = default;
+
+	// no copies: set is meant to be long-living accumulator
+	hashset(const hashset &) = delete;
+	hashset & operator = (const hashset &) = delete;
+
+	void free(void) {
+		if (_slots) allocator_t::free(_slots, _slots_size());
+		_slots = nullptr;
+		_mask = 0;
+		_pool.free();
+	}
+
+	// "bytes" is approximate memory limit (zero means no limit)
+	CC_INLINE
+	void limit(size_t bytes) {
+		_limit = bytes;
+	}
+
+	// memory in use: table, pool and offsets
+	CC_INLINE
+	size_t memory(void) const {
+		return _slots_size() + _pool.allocated() + ((size_t) count() * sizeof(uint32_t));
+	}
+
+	CC_INLINE
+	index_t count(void) const {
+		return _pool.count();
+	}
+
+	// strings are in order of insertion
+	CC_INLINE
+	str_view get_view(index_t index) const {
+		return _pool.get_view(index);
+	}
+
+	bool contains(const char * string, size_t length) const {
+		if ((!string) || (!_slots)) return false;
+
+		return (_lookup(_hash(string, length), string, length)->pos != 0);
+	}
+
+	// returns 1 if string was inserted, 0 if it's already in set
+	// or -1 if it can't be inserted (no memory or memory limit is reached)
+	int insert(const char * string, size_t length) {
+		if (!string) return -1;
+
+		if ((!_slots) && (!_resize(slots_min))) return -1;
+
+		uint32_t hash = _hash(string, length);
+		slot_t * s = _lookup(hash, string, length);
+		if (s->pos) return 0;
+
+		// keep load factor under 3/4
+		size_t n = (size_t) count() + 1;
+		if ((n * 4) > ((_mask + 1) * 3)) {
+			if (!_resize((_mask + 1) * 2)) return -1;
+			s = _lookup(hash, string, length);
+		}
+
+		if (_limit && ((memory() + length + 1 + sizeof(uint32_t)) > _limit)) return -1;
+
+		// compact layout: string is placed right at the end of pool
+		size_t offset = _pool.used();
+		if (offset >= UINT32_MAX) return -1;
+		if (is_inv(_pool.append(string, length))) return -1;
+
+		s->hash = hash;
+		s->pos  = (uint32_t) (offset + 1);
+		return 1;
+	}
+
+	CC_INLINE
+	int insert(const str_view & view) {
+		return insert(view.ptr, view.length);
+	}
+
+};
+
+template<typename allocator_t = memfun_allocator_t<MEMFUN_ZERO>>
+struct bloom {
+
+protected:
+
+	static constexpr int block_words = 8;
+
+	typedef struct {
+		uint32_t word[block_words];
+	} block_t;
+
+	block_t * _blocks = nullptr;
+	// number of blocks minus one (number of blocks is power of 2)
+	size_t _mask = 0;
+
+	static CC_INLINE
+	uint32_t _mask_word(uint32_t key, int n) {
+		static const uint32_t salt[block_words] = {
+			0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+			0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+		};
+		return 1U << ((key * salt[n]) >> 27);
+	}
+
+	CC_INLINE
+	size_t _size(void) const {
+		return (_blocks) ? ((_mask + 1) * sizeof(block_t)) : 0;
+	}
+
+public:
+
+	bloom() = default;
+
+	bloom(const bloom &) = delete;
+	bloom & operator = (const bloom &) = delete;
+
+	// filter takes at most "bytes" bytes (rounded down to power of 2)
+	bool init(size_t bytes) {
+		free();
+
+		size_t n = degree2_currl(bytes / sizeof(block_t));
+		if (!n) n = 1;
+
+		size_t len = n * sizeof(block_t);
+		_blocks = (block_t *) allocator_t::alloc_ex(&len);
+		if (!_blocks) return false;
+
+		_mask = n - 1;
+		return true;
+	}
+
+	void free(void) {
+		if (_blocks) allocator_t::free(_blocks, _size());
+		_blocks = nullptr;
+		_mask = 0;
+	}
+
+	CC_INLINE
+	size_t memory(void) const {
+		return _size();
+	}
+
+	// returns true if "string" (probably) was seen before
+	bool test(const char * string, size_t length) const {
+		if (!_blocks) return false;
+
+		uint64_t h = hash64(string, length);
+		const block_t * b = &(_blocks[(h >> 32) & _mask]);
+		for (int i = 0; i < block_words; i++) {
+			uint32_t m = _mask_word((uint32_t) h, i);
+			if ((b->word[i] & m) != m) return false;
+		}
+		return true;
+	}
+
+	// returns true if "string" was added (i.e. it wasn't seen before for sure)
+	bool insert(const char * string, size_t length) {
+		if (!_blocks) return false;
+
+		uint64_t h = hash64(string, length);
+		block_t * b = &(_blocks[(h >> 32) & _mask]);
+		uint32_t fresh = 0;
+		for (int i = 0; i < block_words; i++) {
+			uint32_t m = _mask_word((uint32_t) h, i);
+			fresh |= m & ~(b->word[i]);
+			b->word[i] |= m;
+		}
+		return (fresh != 0);
+	}
+
+};
+
+} /* namespace uvector */
+
+#endif /* HEADER_INCLUDED_UVECTOR_HASHSET_HH */
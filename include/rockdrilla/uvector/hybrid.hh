@@ -0,0 +1,292 @@
+/* uvector: dynamic array (c++-like version)
+ *
+ * - "hybrid" allocation: items are stored in-place until "inline_count"
+ *   is exceeded, then they're moved to dynamic memory
+ *
+ * Container has no pointers to itself so it's trivially relocatable
+ * (and swap() is plain byte copy).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_UVECTOR_HYBRID_HH
+#define HEADER_INCLUDED_UVECTOR_HYBRID_HH 1
+
+#include "base.hh"
+
+namespace uvector {
+
+template<typename value_t, typename index_t = size_t, index_t inline_count = 0, unsigned int growth_policy = MEMFUN_GROWTH_DEFAULT, typename allocator_t = memfun_allocator>
+struct hybrid : iface<hybrid<value_t, index_t, inline_count, growth_policy, allocator_t>, index_t, const value_t *> {
+
+protected:
+
+	using _base = base<value_t, index_t>;
+	using value_align_t = typename _base::value_align_t;
+
+	static constexpr size_t  item_size  = _base::item_size;
+	static constexpr size_t  align_size = _base::align_size;
+	static constexpr index_t idx_max    = _base::idx_max;
+	static constexpr index_t idx_inv    = _base::idx_inv;
+	static constexpr int     idx_bits   = _base::idx_bits;
+	static constexpr index_t inline_max = (inline_count < idx_max) ? inline_count : idx_max;
+
+	// "_allocated" and "_ptr" refer to dynamic memory (both are zero while items are in-place)
+	index_t _used = 0, _allocated = 0;
+	value_align_t * _ptr = nullptr;
+	// exact allocated length ("_allocated" is rounded down to whole items)
+	size_t _bytes = 0;
+	value_align_t _arr[inline_max];
+
+	CC_INLINE
+	void flush_self(void) {
+		memset(this, 0, sizeof(*this));
+	}
+
+	// in-place items are left as is
+	CC_INLINE
+	void reset_self(void) {
+		_used = _allocated = 0;
+		_ptr = nullptr;
+		_bytes = 0;
+	}
+
+	CC_INLINE
+	value_align_t * _data(void) {
+		return ((inline_max) && (!_ptr)) ? _arr : _ptr;
+	}
+
+	CC_INLINE
+	const value_align_t * _data(void) const {
+		return ((inline_max) && (!_ptr)) ? _arr : _ptr;
+	}
+
+	CC_INLINE
+	const value_t & get_raw(index_t index) const {
+		return _data()[index]._.value;
+	}
+
+	CC_INLINE
+	void set_by_ptr(index_t index, const value_t * source) {
+		auto item = (value_t *) &(_data()[index]);
+
+		if (source)
+			(void) memcpy(item, source, item_size);
+		else
+			(void) memset(item, 0, item_size);
+	}
+
+	// move items to dynamic memory or grow it
+	bool _spill(index_t count) {
+		size_t _old = (_ptr) ? _bytes : 0;
+		size_t _new = _old;
+		size_t extend = _base::offset_of(count - ((_ptr) ? _allocated : 0));
+
+		auto nptr = (value_align_t *) allocator_t::realloc_policy(_ptr, &_new, extend, growth_policy);
+		if ((!nptr) || (_new < _base::offset_of(count))) return false;
+
+		if ((inline_max) && (!_ptr) && _used)
+			(void) memcpy(nptr, _arr, _base::offset_of(_used));
+
+		size_t _alloc = _new / align_size;
+		_allocated = (_alloc < idx_max) ? _alloc : idx_max;
+		_ptr = nptr;
+		_bytes = _new;
+		return true;
+	}
+
+public:
+
+	static CC_INLINE
+	bool is_inv(index_t index) {
+		return ((index >> idx_bits) != 0);
+	}
+
+	hybrid() {
+		flush_self();
+	}
+
+	// deep copy (container is left empty on failure)
+	hybrid(const hybrid & source) {
+		flush_self();
+		copy_from(source);
+	}
+
+	// move: dynamic memory is handed over without allocation, "source" is left empty
+	hybrid(hybrid && source) {
+		flush_self();
+		swap(source);
+	}
+
+	hybrid & operator = (const hybrid & other) {
+		if (this == &other) return *this;
+
+		free();
+		copy_from(other);
+		return *this;
+	}
+
+	hybrid & operator = (hybrid && other) {
+		if (this == &other) return *this;
+
+		free();
+		swap(other);
+		return *this;
+	}
+
+	void swap(hybrid & other) {
+		char tmp[sizeof(*this)];
+		(void) memcpy(tmp, (void *) this, sizeof(*this));
+		(void) memcpy((void *) this, (void *) &other, sizeof(*this));
+		(void) memcpy((void *) &other, tmp, sizeof(*this));
+	}
+
+	// container should be empty;
+	// "source" is any uvector container with same "value_t" (dynmem, inplace or hybrid)
+	template<typename source_t>
+	bool copy_from(const source_t & source) {
+		index_t n = source.used();
+		if (!n) return true;
+		if (!reserve(n)) return false;
+
+		(void) memcpy(_data(), source.get(0), _base::offset_of(n));
+		_used = n;
+		return true;
+	}
+
+	void free(void) {
+		if (_ptr) allocator_t::free(_ptr, _bytes);
+		reset_self();
+	}
+
+	CC_INLINE
+	index_t used(void) const {
+		return _used;
+	}
+
+	CC_INLINE
+	index_t count(void) const {
+		return _used;
+	}
+
+	CC_INLINE
+	index_t allocated(void) const {
+		return (_ptr) ? _allocated : inline_max;
+	}
+
+	// items are stored in-place
+	CC_INLINE
+	bool is_inline(void) const {
+		return (!_ptr);
+	}
+
+	const value_t * get(index_t index) const {
+		if (index >= _used) return nullptr;
+
+		return (const value_t *) &(_data()[index]);
+	}
+
+	CC_INLINE
+	const value_t * get_view(index_t index) const {
+		return get(index);
+	}
+
+	bool set(index_t index, const value_t * source) {
+		if (index >= _used) return false;
+
+		set_by_ptr(index, source);
+		return true;
+	}
+
+	bool set(index_t index, const value_t & source) {
+		if (index >= _used) return false;
+
+		set_by_ptr(index, &source);
+		return true;
+	}
+
+	const value_t get_val(index_t index) const {
+		if (index >= _used) {
+			value_t _default[1] = {};
+			return _default[0];
+		}
+
+		return get_raw(index);
+	}
+
+	const value_t get_val(index_t index, const value_t & fallback) const {
+		if (index >= _used) return fallback;
+
+		return get_raw(index);
+	}
+
+	// room for "count" more items
+	bool reserve(index_t count) {
+		index_t cap = allocated();
+		if ((cap - _used) >= count) return true;
+
+		if (count > (idx_max - _used)) return false;
+
+		return _spill(_used + count);
+	}
+
+	index_t append(const value_t * source) {
+		if (!reserve(1)) return idx_inv;
+
+		set_by_ptr(_used, source);
+		return (_used++);
+	}
+
+	index_t append(const value_t & source) {
+		if (!reserve(1)) return idx_inv;
+
+		set_by_ptr(_used, &source);
+		return (_used++);
+	}
+
+	// append "n" items from plain array (single reservation);
+	// returns index of first appended item
+	index_t append_n(const value_t * source, index_t n) {
+		if (!source) return idx_inv;
+		if (!reserve(n)) return idx_inv;
+
+		if (item_size == align_size) {
+			if (n) (void) memcpy(&(_data()[_used]), source, _base::offset_of(n));
+		} else {
+			for (index_t i = 0; i < n; i++)
+				set_by_ptr(_used + i, &(source[i]));
+		}
+
+		index_t idx = _used;
+		_used += n;
+		return idx;
+	}
+
+	// append items [begin, begin + count) of any uvector container with same "value_t";
+	// returns number of appended items (all or nothing)
+	template<typename source_t>
+	index_t append(const source_t & source, index_t begin, index_t count) {
+		if (begin >= source.used()) return 0;
+
+		if (count > (source.used() - begin))
+			count = source.used() - begin;
+
+		if (!count) return 0;
+		if (!reserve(count)) return 0;
+
+		(void) memcpy(&(_data()[_used]), source.get(begin), _base::offset_of(count));
+		_used += count;
+		return count;
+	}
+
+	template<typename source_t, typename = decltype(((const source_t *) nullptr)->used())>
+	index_t append(const source_t & source) {
+		return append(source, 0, source.used());
+	}
+
+};
+
+} /* namespace uvector */
+
+#endif /* HEADER_INCLUDED_UVECTOR_HYBRID_HH */
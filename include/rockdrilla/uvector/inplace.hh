@@ -17,7 +17,7 @@
 namespace uvector {
 
 template<typename value_t, typename index_t = size_t, index_t max_elements = 0>
-struct inplace {
+struct inplace : iface<inplace<value_t, index_t, max_elements>, index_t, const value_t *> {
 
 protected:
 
@@ -98,6 +98,11 @@ public:
 		return _used;
 	}
 
+	CC_INLINE
+	index_t count(void) const {
+		return _used;
+	}
+
 	CC_INLINE
 	index_t allocated(void) const {
 		return idx_max;
@@ -109,6 +114,11 @@ public:
 		return ptr_of(index);
 	}
 
+	CC_INLINE
+	const value_t * get_view(index_t index) const {
+		return get(index);
+	}
+
 	bool set(index_t index, const value_t * source) {
 		if (index >= _used) return false;
 
@@ -157,9 +167,9 @@ public:
 		if (!source) return 0;
 		if (begin >= source->used()) return 0;
 
-		index_t end = begin + count;
-		if (end > source->used())
+		if (count > (source->used() - begin))
 			count = source->used() - begin;
+		index_t end = begin + count;
 
 		index_t i, k = idx_inv;
 		for (i = begin; i < end; i++) {
@@ -180,9 +190,9 @@ public:
 	index_t append(const dynmem<value_t, index_t, source_growth> & source, index_t begin, index_t count) {
 		if (begin >= source.used()) return 0;
 
-		index_t end = begin + count;
-		if (end > source.used())
+		if (count > (source.used() - begin))
 			count = source.used() - begin;
+		index_t end = begin + count;
 
 		index_t i, k = idx_inv;
 		for (i = begin; i < end; i++) {
@@ -199,32 +209,6 @@ public:
 		return append(source, 0, source.used());
 	}
 
-	void walk(void (*visitor)(index_t, const value_t *)) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, ptr_of(i));
-		}
-	}
-
-	template<typename T = void>
-	void walk(void (*visitor)(index_t, const value_t *, T *), T * state) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, ptr_of(i), state);
-		}
-	}
-
-	void rwalk(void (*visitor)(index_t, const value_t *)) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, ptr_of(i));
-		}
-	}
-
-	template<typename T = void>
-	void rwalk(void (*visitor)(index_t, const value_t *, T *), T * state) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, ptr_of(i), state);
-		}
-	}
-
 };
 
 } /* namespace uvector */
@@ -0,0 +1,362 @@
+/* uvector: bounded ring buffer for passing items between threads (c++-like version)
+ *
+ * - ring_spsc: single producer, single consumer (wait-free):
+ *   each side owns its index and keeps cached copy of the other one,
+ *   so indices' cache lines bounce between cores only when cached copy runs out;
+ * - ring_mpmc: multiple producers, multiple consumers (after [1]):
+ *   every cell has sequence number, ranges of cells are claimed with CAS on shared index
+ *   and published cell by cell; thread which claimed cells but isn't done with them
+ *   delays the others (there're no locks though).
+ *
+ * Both variants:
+ * - capacity is rounded up to power of 2; indices run freely (only differences
+ *   of indices are used so wraparound is harmless);
+ * - slots are laid out with alignment of other uvector containers (see base::align_size);
+ * - indices are placed on separate cache lines (RING_CACHE_LINE) to avoid false sharing;
+ * - push_n() and pop_n() move ranges of items with single index update
+ *   (ring_spsc) or single CAS (ring_mpmc) and return number of moved items
+ *   (which may be less than requested);
+ * - items are copied with memcpy(3) so "value_t" should be trivially copyable;
+ * - container itself should be aligned (i.e. static or automatic storage,
+ *   or "new" with C++17 aligned allocation).
+ *
+ * refs:
+ * - [1] https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_UVECTOR_RING_HH
+#define HEADER_INCLUDED_UVECTOR_RING_HH 1
+
+#include "../misc/ext-c-begin.h"
+#include <sched.h>
+#include "../misc/ext-c-end.h"
+
+#include "base.hh"
+#include "../num/degree2.h"
+
+#ifndef RING_CACHE_LINE
+#define RING_CACHE_LINE  64
+#endif
+
+namespace uvector {
+
+#ifndef RING_SPIN_MAX
+#define RING_SPIN_MAX  128
+#endif
+
+// spin for a while then give up CPU:
+// thread which is waited for may be preempted (e.g. there're more threads than CPUs)
+static CC_FORCE_INLINE
+void _ring_relax(unsigned int * spins)
+{
+	if ((*spins)++ >= RING_SPIN_MAX) {
+		*spins = 0;
+		(void) sched_yield();
+		return;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__ ("yield" ::: "memory");
+#endif
+}
+
+// capacity: power of 2 (or zero if it's too large)
+static CC_INLINE
+size_t _ring_capacity(size_t count)
+{
+	if (count < 2) count = 2;
+	return degree2_nextl(count - 1);
+}
+
+template<typename value_t, typename allocator_t = memfun_allocator>
+struct ring_spsc {
+
+protected:
+
+	using _base = base<value_t, size_t>;
+	using value_align_t = typename _base::value_align_t;
+
+	// consumer side
+	alignas(RING_CACHE_LINE) size_t _head = 0;
+	size_t _tail_cache = 0;
+
+	// producer side
+	alignas(RING_CACHE_LINE) size_t _tail = 0;
+	size_t _head_cache = 0;
+
+	// read-only after init()
+	alignas(RING_CACHE_LINE) value_align_t * _data = nullptr;
+	size_t _mask = 0;
+	size_t _allocated = 0;
+
+public:
+
+	ring_spsc() = default;
+
+	// no copies: ring is shared between threads
+	ring_spsc(const ring_spsc &) = delete;
+	ring_spsc & operator = (const ring_spsc &) = delete;
+
+	// not thread-safe (call before threads start)
+	bool init(size_t capacity) {
+		free();
+
+		size_t cap = _ring_capacity(capacity);
+		if ((!cap) || (cap > (SIZE_MAX / _base::align_size))) return false;
+
+		size_t len = _base::offset_of(cap);
+		_data = (value_align_t *) allocator_t::alloc_ex(&len);
+		if (!_data) return false;
+
+		_allocated = len;
+		_mask = cap - 1;
+		_head = _tail = _head_cache = _tail_cache = 0;
+		return true;
+	}
+
+	// not thread-safe (call after threads stop)
+	void free(void) {
+		if (_data) allocator_t::free(_data, _allocated);
+		_data = nullptr;
+		_mask = _allocated = 0;
+		_head = _tail = _head_cache = _tail_cache = 0;
+	}
+
+	CC_INLINE
+	size_t capacity(void) const {
+		return (_data) ? (_mask + 1) : 0;
+	}
+
+	// approximate (exact if both sides are idle)
+	size_t count(void) const {
+		size_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+		size_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+		return tail - head;
+	}
+
+	// producer: returns number of pushed items
+	size_t push_n(const value_t * items, size_t n) {
+		if ((!_data) || (!items) || (!n)) return 0;
+
+		const size_t cap = _mask + 1;
+		size_t tail = _tail;
+
+		size_t room = cap - (tail - _head_cache);
+		if (room < n) {
+			_head_cache = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+			room = cap - (tail - _head_cache);
+		}
+		if (n > room) n = room;
+
+		for (size_t i = 0; i < n; i++)
+			(void) memcpy(&(_data[(tail + i) & _mask]), &(items[i]), _base::item_size);
+
+		__atomic_store_n(&_tail, tail + n, __ATOMIC_RELEASE);
+		return n;
+	}
+
+	CC_INLINE
+	bool push(const value_t & item) {
+		return (push_n(&item, 1) == 1);
+	}
+
+	// consumer: returns number of popped items
+	size_t pop_n(value_t * items, size_t n) {
+		if ((!_data) || (!items) || (!n)) return 0;
+
+		size_t head = _head;
+
+		size_t avail = _tail_cache - head;
+		if (avail < n) {
+			_tail_cache = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+			avail = _tail_cache - head;
+		}
+		if (n > avail) n = avail;
+
+		for (size_t i = 0; i < n; i++)
+			(void) memcpy(&(items[i]), &(_data[(head + i) & _mask]), _base::item_size);
+
+		__atomic_store_n(&_head, head + n, __ATOMIC_RELEASE);
+		return n;
+	}
+
+	CC_INLINE
+	bool pop(value_t & item) {
+		return (pop_n(&item, 1) == 1);
+	}
+
+};
+
+template<typename value_t, typename allocator_t = memfun_allocator>
+struct ring_mpmc {
+
+protected:
+
+	typedef struct {
+		// position of cell (for producers) or position plus one (for consumers)
+		size_t seq;
+		value_t value;
+	} cell_t;
+
+	using _base = base<cell_t, size_t>;
+	using cell_align_t = typename _base::value_align_t;
+
+	// consumers' index
+	alignas(RING_CACHE_LINE) size_t _head = 0;
+
+	// producers' index
+	alignas(RING_CACHE_LINE) size_t _tail = 0;
+
+	// read-only after init()
+	alignas(RING_CACHE_LINE) cell_align_t * _cells = nullptr;
+	size_t _mask = 0;
+	size_t _allocated = 0;
+
+	CC_INLINE
+	cell_t * _cell(size_t pos) const {
+		return (cell_t *) &(_cells[pos & _mask]);
+	}
+
+public:
+
+	ring_mpmc() = default;
+
+	ring_mpmc(const ring_mpmc &) = delete;
+	ring_mpmc & operator = (const ring_mpmc &) = delete;
+
+	// not thread-safe (call before threads start)
+	bool init(size_t capacity) {
+		free();
+
+		size_t cap = _ring_capacity(capacity);
+		if ((!cap) || (cap > (SIZE_MAX / _base::align_size))) return false;
+
+		size_t len = _base::offset_of(cap);
+		_cells = (cell_align_t *) allocator_t::alloc_ex(&len);
+		if (!_cells) return false;
+
+		_allocated = len;
+		_mask = cap - 1;
+		for (size_t i = 0; i < cap; i++)
+			_cell(i)->seq = i;
+
+		_head = _tail = 0;
+		return true;
+	}
+
+	// not thread-safe (call after threads stop)
+	void free(void) {
+		if (_cells) allocator_t::free(_cells, _allocated);
+		_cells = nullptr;
+		_mask = _allocated = 0;
+		_head = _tail = 0;
+	}
+
+	CC_INLINE
+	size_t capacity(void) const {
+		return (_cells) ? (_mask + 1) : 0;
+	}
+
+	// approximate
+	size_t count(void) const {
+		size_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+		size_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+		size_t n = tail - head;
+		return (n > capacity()) ? 0 : n;
+	}
+
+	// returns number of pushed items
+	size_t push_n(const value_t * items, size_t n) {
+		if ((!_cells) || (!items) || (!n)) return 0;
+
+		const size_t cap = _mask + 1;
+		size_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+		size_t k;
+		for (;;) {
+			size_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+			size_t used = tail - head;
+			// "tail" is stale
+			if (used > cap) {
+				tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+				continue;
+			}
+			if (used == cap) return 0;
+
+			k = cap - used;
+			if (k > n) k = n;
+
+			if (__atomic_compare_exchange_n(&_tail, &tail, tail + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+
+		for (size_t i = 0; i < k; i++) {
+			cell_t * c = _cell(tail + i);
+			// consumer of previous lap may still copy item out
+			unsigned int spins = 0;
+			while (__atomic_load_n(&(c->seq), __ATOMIC_ACQUIRE) != (tail + i))
+				_ring_relax(&spins);
+
+			(void) memcpy(&(c->value), &(items[i]), sizeof(value_t));
+			__atomic_store_n(&(c->seq), tail + i + 1, __ATOMIC_RELEASE);
+		}
+
+		return k;
+	}
+
+	CC_INLINE
+	bool push(const value_t & item) {
+		return (push_n(&item, 1) == 1);
+	}
+
+	// returns number of popped items
+	size_t pop_n(value_t * items, size_t n) {
+		if ((!_cells) || (!items) || (!n)) return 0;
+
+		const size_t cap = _mask + 1;
+		size_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+		size_t k;
+		for (;;) {
+			size_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+			k = tail - head;
+			// "head" is stale
+			if (k > cap) {
+				head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+				continue;
+			}
+			if (!k) return 0;
+
+			if (k > n) k = n;
+
+			if (__atomic_compare_exchange_n(&_head, &head, head + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+
+		for (size_t i = 0; i < k; i++) {
+			cell_t * c = _cell(head + i);
+			// producer may still copy item in
+			unsigned int spins = 0;
+			while (__atomic_load_n(&(c->seq), __ATOMIC_ACQUIRE) != (head + i + 1))
+				_ring_relax(&spins);
+
+			(void) memcpy(&(items[i]), &(c->value), sizeof(value_t));
+			__atomic_store_n(&(c->seq), head + i + cap, __ATOMIC_RELEASE);
+		}
+
+		return k;
+	}
+
+	CC_INLINE
+	bool pop(value_t & item) {
+		return (pop_n(&item, 1) == 1);
+	}
+
+};
+
+} /* namespace uvector */
+
+#endif /* HEADER_INCLUDED_UVECTOR_RING_HH */
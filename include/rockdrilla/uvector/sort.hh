@@ -0,0 +1,81 @@
+/* uvector: sort strings of "str" container (c++-like version)
+ *
+ * Order is bytewise (like memcmp(3); string which is prefix of another one goes first),
+ * i.e. same as "LC_ALL=C sort".
+ *
+ * Container is not modified: sorted order is written to array of "sort_item"
+ * (view of string and its first 8 bytes in big-endian order), so most comparisons
+ * don't touch container at all. Items are valid until container is modified.
+ *
+ * qsort_r(3) is GNU extension (glibc >= 2.8).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * (c) 2022-2023, Konstantin Demin
+ */
+
+#ifndef HEADER_INCLUDED_UVECTOR_SORT_HH
+#define HEADER_INCLUDED_UVECTOR_SORT_HH 1
+
+#include "../misc/ext-c-begin.h"
+#include <stdlib.h>
+#include "../misc/ext-c-end.h"
+
+#include "str.hh"
+
+namespace uvector {
+
+typedef struct {
+	uint64_t prefix;
+	str_view view;
+} sort_item;
+
+static CC_INLINE
+uint64_t sort_prefix(const char * ptr, size_t length)
+{
+	uint64_t x = 0;
+	(void) memcpy(&x, ptr, (length < sizeof(x)) ? length : sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	return x;
+}
+
+// returns negative value, zero or positive value (like memcmp(3))
+static CC_INLINE
+int sort_compare(const str_view & a, const str_view & b)
+{
+	int r = memcmp(a.ptr, b.ptr, (a.length < b.length) ? a.length : b.length);
+	if (r) return r;
+
+	return (a.length < b.length) ? -1 : (a.length > b.length);
+}
+
+static
+int _sort_item_compare(const void * p1, const void * p2, void *)
+{
+	auto a = (const sort_item *) p1;
+	auto b = (const sort_item *) p2;
+
+	// prefixes differ only if strings differ in first 8 bytes
+	if (a->prefix != b->prefix)
+		return (a->prefix < b->prefix) ? -1 : 1;
+
+	return sort_compare(a->view, b->view);
+}
+
+// "items" should have room for source.count() items
+template<typename str_t>
+void sort_views(const str_t & source, sort_item * items)
+{
+	const auto n = source.count();
+	for (decltype(source.count()) i = 0; i < n; i++) {
+		items[i].view   = source.get_view(i);
+		items[i].prefix = sort_prefix(items[i].view.ptr, items[i].view.length);
+	}
+
+	qsort_r(items, n, sizeof(sort_item), _sort_item_compare, nullptr);
+}
+
+} /* namespace uvector */
+
+#endif /* HEADER_INCLUDED_UVECTOR_SORT_HH */
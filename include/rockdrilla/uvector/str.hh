@@ -2,6 +2,16 @@
  *
  * - "contiguous" string stream
  *
+ * Layouts:
+ * - default: strings are aligned by sizeof(size_t), offsets are size_t,
+ *   lengths are derived from offsets and (at most sizeof(size_t) bytes of) padding;
+ * - compact (str_compact): strings are byte-packed and offsets are 32-bit
+ *   (so pool is limited to 4 GiB), lengths are derived from offsets.
+ *
+ * Optional in-place storage: first "inline_bytes" of pool (and offsets of
+ * "inline_bytes / 8" strings) are stored in container itself (see hybrid.hh),
+ * so small lists need no dynamic memory at all.
+ *
  * SPDX-License-Identifier: Apache-2.0
  * (c) 2022-2023, Konstantin Demin
  */
@@ -9,35 +19,102 @@
 #ifndef HEADER_INCLUDED_UVECTOR_STR_HH
 #define HEADER_INCLUDED_UVECTOR_STR_HH
 
+#include <stdint.h>
+
 #include "base.hh"
 #include "dynmem.hh"
+#include "hybrid.hh"
 
 namespace uvector {
 
-template<typename index_t = unsigned int>
-struct str {
+// string with known length (terminated with '\0' anyway)
+typedef struct {
+	const char * ptr;
+	size_t length;
+} str_view;
+
+template<bool compact>
+struct _str_layout {
+	typedef size_t offset_t;
+	static constexpr size_t align = sizeof(size_t);
+};
+
+template<>
+struct _str_layout<true> {
+	typedef uint32_t offset_t;
+	static constexpr size_t align = 1;
+};
+
+template<typename offset_t, typename index_t, size_t inline_bytes, unsigned int growth_policy, typename allocator_t>
+struct _str_offsets {
+	typedef hybrid<offset_t, index_t, (index_t) (inline_bytes / 8), growth_policy, allocator_t> type;
+};
+
+template<typename offset_t, typename index_t, unsigned int growth_policy, typename allocator_t>
+struct _str_offsets<offset_t, index_t, 0, growth_policy, allocator_t> {
+	typedef dynmem<offset_t, index_t, 0, growth_policy, allocator_t> type;
+};
+
+template<typename index_t = unsigned int, unsigned int growth_policy = MEMFUN_GROWTH_DEFAULT, typename allocator_t = memfun_allocator, bool compact = false, size_t inline_bytes = 0>
+struct str : iface<str<index_t, growth_policy, allocator_t, compact, inline_bytes>, index_t, str_view> {
 
 protected:
 
-	using _base = base<size_t, index_t>;
+	using _layout = _str_layout<compact>;
+	using offset_t = typename _layout::offset_t;
+	using _base = base<offset_t, index_t>;
+
+	static constexpr size_t  offset_max = (offset_t) ~((offset_t) 0);
 
 	static constexpr size_t  item_size = _base::item_size;
 	static constexpr index_t idx_max   = _base::idx_max;
 	static constexpr index_t idx_inv   = _base::idx_inv;
 	static constexpr int     idx_bits  = _base::idx_bits;
 
+	// "_allocated" and "_ptr" refer to dynamic memory (both are zero while pool is in-place)
 	size_t _used = 0, _allocated = 0;
 	char * _ptr = nullptr;
-	dynmem<size_t, index_t> _offsets;
+	typename _str_offsets<offset_t, index_t, inline_bytes, growth_policy, allocator_t>::type _offsets;
+	char _inline[inline_bytes];
 
 	CC_INLINE
 	void flush_self(void) {
 		memset(this, 0, sizeof(*this));
 	}
 
+	CC_INLINE
+	char * _pool(void) {
+		return ((inline_bytes) && (!_ptr)) ? _inline : _ptr;
+	}
+
+	CC_INLINE
+	const char * _pool(void) const {
+		return ((inline_bytes) && (!_ptr)) ? _inline : _ptr;
+	}
+
+	CC_INLINE
+	size_t _capacity(void) const {
+		return (_ptr) ? _allocated : inline_bytes;
+	}
+
 	CC_INLINE
 	const char * _get(index_t index) const {
-		return memfun_t_ptr_offset(_ptr, _offsets.get_val(index));
+		return _pool() + _offsets.get_val(index);
+	}
+
+	// length is derived from offsets (no strlen(3)):
+	// with default layout terminator is followed by up to (align - 1) bytes of zero padding
+	CC_INLINE
+	size_t _length(index_t index) const {
+		size_t start = _offsets.get_val(index);
+		size_t end = ((index + 1) < count()) ? _offsets.get_val(index + 1) : _used;
+		size_t n = end - start - 1;
+		if (compact) return n;
+
+		const char * s = _pool() + start;
+		for (size_t i = 1; (i < _layout::align) && n && (!s[n - 1]); i++)
+			n--;
+		return n;
 	}
 
 public:
@@ -51,32 +128,62 @@ public:
 		flush_self();
 	}
 
+	// deep copy (container is left empty on failure)
 	str(const str & source) {
 		flush_self();
+		copy_from(source);
+	}
 
-		_used = _allocated = source._used;
-		_ptr = memfun_t_alloc_ex<char>(&_allocated);
-		if (!_ptr) {
-			flush_self();
-			return;
-		}
+	// move: memory is handed over without allocation, "source" is left empty
+	str(str && source) {
+		flush_self();
+		swap(source);
+	}
 
-		_offsets = dynmem(source._offsets);
-		if (!_offsets.allocated()) {
-			memfun_t_free(_ptr, 0);
-			flush_self();
-			return;
-		}
+	str & operator = (const str & other) {
+		if (this == &other) return *this;
 
-		memcpy(_ptr, source.get(0), _used);
+		free();
+		copy_from(other);
+		return *this;
 	}
 
-	str & operator = (const str & other) = default;
+	str & operator = (str && other) {
+		if (this == &other) return *this;
 
+		free();
+		swap(other);
+		return *this;
+	}
+
+	// container is trivially relocatable (no pointers to itself)
+	void swap(str & other) {
+		char tmp[sizeof(*this)];
+		(void) memcpy(tmp, (void *) this, sizeof(*this));
+		(void) memcpy((void *) this, (void *) &other, sizeof(*this));
+		(void) memcpy((void *) &other, tmp, sizeof(*this));
+	}
+
+	// container should be empty
+	bool copy_from(const str & source) {
+		if (!source.count()) return true;
+
+		if ((!reserve(source._used)) || (!_offsets.copy_from(source._offsets))) {
+			free();
+			return false;
+		}
+
+		(void) memcpy(_pool(), source._pool(), source._used);
+		_used = source._used;
+		return true;
+	}
+
+	// in-place storage is left as is
 	void free(void) {
 		_offsets.free();
-		memfun_free(_ptr, _used);
-		flush_self();
+		if (_ptr) allocator_t::free(_ptr, _allocated);
+		_used = _allocated = 0;
+		_ptr = nullptr;
 	}
 
 	CC_INLINE
@@ -86,7 +193,13 @@ public:
 
 	CC_INLINE
 	size_t allocated(void) const {
-		return _allocated;
+		return _capacity();
+	}
+
+	// pool is stored in-place
+	CC_INLINE
+	bool is_inline(void) const {
+		return (!_ptr);
 	}
 
 	CC_INLINE
@@ -100,96 +213,153 @@ public:
 		return _get(index);
 	}
 
+	// raw pool: strings are NUL-terminated and stored in order of insertion
+	// (back to back with compact layout, so offset of next string is used())
+	CC_INLINE
+	const char * data(void) const {
+		return _pool();
+	}
+
+	size_t length(index_t index) const {
+		if (index >= count()) return 0;
+
+		return _length(index);
+	}
+
+	str_view get_view(index_t index) const {
+		if (index >= count()) return { nullptr, 0 };
+
+		return { _get(index), _length(index) };
+	}
+
+	// room for "bytes" more bytes in pool and "count" more strings
+	bool reserve(size_t bytes, index_t count = 0) {
+		size_t new_used = 0;
+		if (!uaddl(_used, bytes, &new_used)) return false;
+
+		if (new_used > _capacity()) {
+			// move pool from in-place storage to dynamic memory
+			size_t _new = _allocated;
+			auto nptr = (char *) allocator_t::realloc_policy(_ptr, &_new, new_used - _allocated, growth_policy);
+			if (new_used > _new) return false;
+
+			if ((inline_bytes) && (!_ptr) && _used)
+				(void) memcpy(nptr, _inline, _used);
+
+			_ptr = nptr;
+			_allocated = _new;
+		}
+
+		return (_offsets.reserve(count));
+	}
+
 	template<typename T = unsigned int>
 	index_t append(const char * string, T length) {
 		if (!string) return idx_inv;
 		if (length < 0) return idx_inv;
 
-		size_t new_used = roundbyl(_used + length + 1, sizeof(size_t));
-		if (new_used > _allocated) {
-			auto nptr = memfun_t_realloc_ex(_ptr, &(_allocated), length + 1);
-			if (!nptr) return idx_inv;
+		if (_used > offset_max) return idx_inv;
 
-			_ptr = nptr;
-		}
+		size_t new_used = _used + length + 1;
+		if (!compact) new_used = roundbyl(new_used, _layout::align);
+
+		// string from own pool: pool may be moved by reserve()
+		const char * pool = _pool();
+		size_t own = ((string >= pool) && (string < (pool + _used))) ? (size_t) (string - pool) : SIZE_MAX;
+		if (!reserve(new_used - _used)) return idx_inv;
+		if (own != SIZE_MAX) string = _pool() + own;
 
-		index_t idx = _offsets.append(_used);
+		index_t idx = _offsets.append((offset_t) _used);
 		if (is_inv(idx)) return idx_inv;
 
+		char * dst = _pool() + _used;
 		if (length > 0)
-			(void) memcpy(memfun_t_ptr_offset(_ptr, _used), string, length);
+			(void) memcpy(dst, string, length);
+		// terminator and padding (memory is not zeroed by allocator)
+		(void) memset(dst + length, 0, new_used - _used - length);
 
 		_used = new_used;
 
 		return idx;
 	}
 
+	CC_INLINE
+	index_t append(const str_view & view) {
+		return append<size_t>(view.ptr, view.length);
+	}
+
 	CC_INLINE
 	index_t append(const char * string) {
 		return append<size_t>(string, (string) ? strlen(string) : 0);
 	}
 
-	index_t append(const str & source, index_t begin, index_t count) {
+	// append strings [begin, begin + count);
+	// same layout: pool is copied with single memcpy(3) and offsets are rebased;
+	// returns number of appended strings
+	template<unsigned int source_policy, typename source_allocator, bool source_compact, size_t source_inline>
+	index_t append(const str<index_t, source_policy, source_allocator, source_compact, source_inline> & source, index_t begin, index_t count) {
 		if (begin >= source.count()) return 0;
 
-		index_t end = begin + count;
-		if (end > source.used())
-			count = source.used() - begin;
+		if (count > (source.count() - begin))
+			count = source.count() - begin;
 
-		index_t i, k = idx_inv;
-		for (i = begin; i < end; i++) {
-			k = append(source.get(i));
-			if (is_inv(k)) break;
+		if (source_compact != compact) {
+			index_t i;
+			for (i = 0; i < count; i++) {
+				if (is_inv(append(source.get_view(begin + i))))
+					break;
+			}
+			return i;
 		}
 
-		if (is_inv(k)) count = i - begin;
+		if (!count) return 0;
+
+		// source may be this container: its pool may be moved by reserve()
+		// so range is kept as offsets until then
+		index_t end = begin + count;
+		size_t first = source.get(begin) - source.data();
+		size_t last = (end < source.count()) ? (size_t) (source.get(end) - source.data()) : source.used();
+		size_t bytes = last - first;
+
+		// offset of last string should fit
+		if (_used > (offset_max - ((size_t) (source.get(end - 1) - source.data()) - first))) return 0;
+		if (!reserve(bytes, count)) return 0;
+
+		(void) memcpy(_pool() + _used, source.data() + first, bytes);
+		for (index_t i = begin; i < end; i++)
+			(void) _offsets.append((offset_t) (_used + ((size_t) (source.get(i) - source.data()) - first)));
+
+		_used += bytes;
 		return count;
 	}
 
-	index_t append(const str & source) {
+	template<unsigned int source_policy, typename source_allocator, bool source_compact, size_t source_inline>
+	index_t append(const str<index_t, source_policy, source_allocator, source_compact, source_inline> & source) {
 		return append(source, 0, source.count());
 	}
 
+	// list should be released with allocator_t::free(list, *length)
 	template<typename T = const char * const>
-	T * to_ptrlist(void) const {
-		auto ptrlist = (const char **) memfun_alloc((_offsets.used() + 1) * sizeof(char *));
+	T * to_ptrlist(size_t * length = nullptr) const {
+		size_t _length = (_offsets.used() + 1) * sizeof(char *);
+		auto ptrlist = (const char **) allocator_t::alloc_ex(&_length);
 		if (!ptrlist) return nullptr;
 
+		if (length) *length = _length;
+
 		for (index_t i = 0; i < count(); i++) {
 			ptrlist[i] = get(i);
 		}
+		ptrlist[count()] = nullptr;
 
 		return (T *) ptrlist;
 	}
 
-	void walk(void (*visitor)(index_t, const char *)) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, get(i));
-		}
-	}
-
-	template<typename T = void>
-	void walk(void (*visitor)(index_t, const char *, T *), T * state) const {
-		for (index_t i = 0; i < _used; i++) {
-			visitor(i, get(i), state);
-		}
-	}
-
-	void rwalk(void (*visitor)(index_t, const char *)) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, get(i));
-		}
-	}
-
-	template<typename T = void>
-	void rwalk(void (*visitor)(index_t, const char *, T *), T * state) const {
-		for (index_t i = _used; (i--) != 0; ) {
-			visitor(i, get(i), state);
-		}
-	}
-
 };
 
+template<typename index_t = unsigned int, unsigned int growth_policy = MEMFUN_GROWTH_DEFAULT, typename allocator_t = memfun_allocator, size_t inline_bytes = 0>
+using str_compact = str<index_t, growth_policy, allocator_t, true, inline_bytes>;
+
 } /* namespace uvector */
 
 #endif /* HEADER_INCLUDED_UVECTOR_STR_HH */
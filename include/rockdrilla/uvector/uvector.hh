@@ -9,7 +9,11 @@
 
 #include "base.hh"
 #include "dynmem.hh"
+#include "hashset.hh"
+#include "hybrid.hh"
 #include "inplace.hh"
+#include "ring.hh"
+#include "sort.hh"
 #include "str.hh"
 
 #endif /* HEADER_INCLUDED_UVECTOR_HH */
@@ -20,6 +20,11 @@
 #define _GNU_SOURCE
 #endif
 
+// read buffers and arena chunks live through whole run
+#ifndef MEMFUN_MMAP_THRESHOLD
+#define MEMFUN_MMAP_THRESHOLD (128 * 1024)
+#endif
+
 #define _LARGEFILE_SOURCE
 #define _FILE_OFFSET_BITS 64
 #define __STDC_WANT_LIB_EXT1__ 1
@@ -35,24 +40,86 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
 
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 
 #include <rockdrilla/misc/ext-c-end.h>
 
 #include <rockdrilla/io/const.h>
 #include <rockdrilla/io/log-stderr.h>
+#include <rockdrilla/io/trace-event.h>
+#include <rockdrilla/misc/arena.hh>
+#include <rockdrilla/misc/file-locality.h>
+#include <rockdrilla/misc/monotime.h>
+#include <rockdrilla/misc/perf-counters.h>
+#include <rockdrilla/misc/usdt.h>
 #include <rockdrilla/uvector/uvector.hh>
 
 #define XVP_OPTS "a:cfhinsu"
 
+enum {
+	XVP_OPT_SPECULATE = 0x100,
+	XVP_OPT_STATS,
+	XVP_OPT_PLAN,
+	XVP_OPT_TRACE,
+	XVP_OPT_RUSAGE,
+	XVP_OPT_PERF,
+	XVP_OPT_UNIQUE,
+	XVP_OPT_UNIQUE_APPROX,
+	XVP_OPT_SORT,
+	XVP_OPT_LOCALITY,
+	XVP_OPT_LOCALITY_EXTENT,
+};
+
+static const struct option xvp_long_opts[] = {
+	{ "speculate", optional_argument, nullptr, XVP_OPT_SPECULATE },
+	{ "stats",     optional_argument, nullptr, XVP_OPT_STATS },
+	{ "plan",      no_argument,       nullptr, XVP_OPT_PLAN },
+	{ "trace",     required_argument, nullptr, XVP_OPT_TRACE },
+	{ "rusage",    optional_argument, nullptr, XVP_OPT_RUSAGE },
+	{ "perf",      no_argument,       nullptr, XVP_OPT_PERF },
+	{ "unique",        optional_argument, nullptr, XVP_OPT_UNIQUE },
+	{ "unique-approx", optional_argument, nullptr, XVP_OPT_UNIQUE_APPROX },
+	{ "sort",          optional_argument, nullptr, XVP_OPT_SORT },
+	{ "locality",        optional_argument, nullptr, XVP_OPT_LOCALITY },
+	{ "locality-extent", optional_argument, nullptr, XVP_OPT_LOCALITY_EXTENT },
+	{ nullptr,     0,                 nullptr, 0 },
+};
+
+// straggler speculation: factor over median batch run time
+#define XVP_SPEC_FACTOR_DEFAULT  3
+#define XVP_SPEC_FACTOR_MAX      1000
+// straggler speculation: number of (recent) batch run times to track
+#define XVP_SPEC_WINDOW          31
+// straggler speculation: minimal number of tracked batches to start with
+#define XVP_SPEC_SAMPLES_MIN     3
+// straggler speculation: don't speculate on batches shorter than this
+#define XVP_SPEC_NSEC_MIN        (10 * MONOTIME_NSEC_PER_MSEC)
+
+// argument de-duplication: memory limit in MiB
+#define XVP_UNIQUE_MIB_DEFAULT   64
+#define XVP_UNIQUE_MIB_MAX       (SIZE_MAX >> 20)
+
+// sorted batching: memory budget in MiB (sorted runs which exceed it are spilled to temporary files)
+#define XVP_SORT_MIB_DEFAULT     64
+#define XVP_SORT_MIB_MAX         (SIZE_MAX >> 20)
+// sorted batching: write buffer for spilled runs
+#define XVP_SORT_WBUF            (256 * 1024)
+
+// disk locality: number of arguments to reorder at once
+#define XVP_LOCALITY_WINDOW_DEFAULT  8192
+#define XVP_LOCALITY_WINDOW_MAX      (1024 * 1024)
+
 static void usage(int retcode)
 {
 	(void) fputs(
 	"xvp 0.3.0\n"
-	"Usage: xvp [-a <arg0>] [-cfhinsu] <program> [..<common args>] {<arg file>|-}\n"
+	"Usage: xvp [-a <arg0>] [-cfhinsu] [--speculate[=<factor>]] [--stats[=<fd>]] [--plan] [--trace=<file>] [--rusage[=<fd>]] [--perf] [--unique[=<MiB>]|--unique-approx[=<MiB>]] [--sort[=<MiB>]|--locality[=<window>]|--locality-extent[=<window>]] <program> [..<common args>] {<arg file>|-}\n"
 	" -a <arg0> - arg0 (set argv[0] for <program> to <arg0>)\n"
 	" -c        - clean env (run <program> with empty environment)\n"
 	" -h        - help (show this message)\n"
@@ -61,12 +128,50 @@ static void usage(int retcode)
 	" -f        - force (force _single_ <program> execution or return error)\n"
 	" -s        - strict (stop after first failed child process)\n"
 	" -u        - unlink (delete <arg file> if it's regular file)\n"
+	" --speculate[=<factor>]\n"
+	"           - speculate (run duplicate of batch which runs <factor> times\n"
+	"             longer than median batch; default factor: 3)\n"
+	" --stats[=<fd>]\n"
+	"           - statistics (write run statistics in JSON to <fd> at exit;\n"
+	"             default fd: 2)\n"
+	" --plan    - plan (print batch plan and do not run <program>)\n"
+	" --trace=<file>\n"
+	"           - trace (write timeline of run to <file> in Chrome trace-event format)\n"
+	" --rusage[=<fd>]\n"
+	"           - resource usage (write resource usage of each batch and total\n"
+	"             in JSON lines to <fd>; default fd: 2)\n"
+	" --perf    - performance counters (count CPU cycles, instructions, cache misses\n"
+	"             and page faults in phases of xvp itself; implies \"--stats\")\n"
+	" --unique[=<MiB>]\n"
+	"           - unique (skip repeated arguments keeping order of first occurrences;\n"
+	"             arguments are remembered in up to <MiB> of memory, default: 64)\n"
+	" --unique-approx[=<MiB>]\n"
+	"           - approximate unique (same as \"--unique\" but arguments are tracked\n"
+	"             with Bloom filter of <MiB> size: memory is fixed but rare unique\n"
+	"             argument may be skipped as repeated one; default: 64)\n"
+	" --sort[=<MiB>]\n"
+	"           - sort (order arguments bytewise before batching; arguments which\n"
+	"             don't fit into <MiB> of memory are sorted in runs spilled to\n"
+	"             temporary files in $TMPDIR and merged; default: 64)\n"
+	" --locality[=<window>]\n"
+	"           - locality (reorder every <window> arguments by device and inode\n"
+	"             of files they name, so files are processed in on-disk order;\n"
+	"             default window: 8192)\n"
+	" --locality-extent[=<window>]\n"
+	"           - same as \"--locality\" but regular files are ordered by physical\n"
+	"             offset of their first extent (FIEMAP) where file system reports it\n"
 	"\n"
 	" <arg file> - file with NUL-separated arguments or stdin if \"-\" was specified\n"
 	"\n"
 	" Notes:\n"
 	" - options \"-n\" and \"-s\" are mutually exclusive;\n"
-	" - option \"-u\" is ignored if reading from stdin.\n"
+	" - options \"-n\" and \"--speculate\" are mutually exclusive;\n"
+	" - option \"--speculate\" is meant only for idempotent <program>;\n"
+	" - if child process which is waited for is killed by signal then xvp exits\n"
+	"   with code 128 + signal number (including \"-s\"; same as shell does);\n"
+	" - options \"--unique\" and \"--unique-approx\" are mutually exclusive;\n"
+	" - options \"--sort\", \"--locality\" and \"--locality-extent\" are mutually exclusive;\n"
+	" - option \"-u\" is ignored if reading from stdin or with \"--plan\".\n"
 	, stderr);
 
 	exit(retcode);
@@ -75,14 +180,34 @@ static void usage(int retcode)
 static struct {
 	char * Arg0;
 	uint8_t
+	  _Fork_last,
+	  _Own_pgrp,
 	  _Script_stdin,
+	  _Track,
 	  Clean_env,
 	  Force_once,
 	  Info_only,
+	  Locality,
+	  Locality_extent,
 	  No_wait,
+	  Perf,
+	  Plan,
+	  Rusage,
+	  Sort,
+	  Stats,
 	  Strict,
+	  Trace,
+	  Unique,
+	  Unique_approx,
 	  Unlink_argfile
 	;
+	unsigned int Speculate;
+	size_t Unique_mib;
+	size_t Sort_mib;
+	unsigned int Locality_window;
+	int Rusage_fd;
+	int Stats_fd;
+	const char * Trace_file;
 } opt;
 
 static const char * callee = nullptr;
@@ -106,13 +231,20 @@ int main(int argc, char * argv[])
 static int handle_file_type(uint32_t type, const char * arg);
 static void dump_error(int error_num, const char * where);
 static void dump_path_error(int error_num, const char * where, const char * name);
+static void stats_dump(void);
+static void rusage_dump(void);
+static int trace_open(const char * path);
+static int perf_open(void);
+static void trace_done(void);
+static int parse_uint(const char * arg, unsigned long * value);
 
 static void parse_opts(int argc, char * argv[])
 {
 	memset(&opt, 0, sizeof(opt));
 
 	int o;
-	while ((o = getopt(argc, (char * const *) argv, "++" XVP_OPTS)) != -1) {
+	unsigned long x;
+	while ((o = getopt_long(argc, (char * const *) argv, "++" XVP_OPTS, xvp_long_opts, nullptr)) != -1) {
 		switch (o) {
 		case 'h':
 			usage(0);
@@ -134,7 +266,7 @@ static void parse_opts(int argc, char * argv[])
 			opt.Info_only = 1;
 			continue;
 		case 'n':
-			if (opt.No_wait || opt.Strict) break;
+			if (opt.No_wait || opt.Strict || opt.Speculate) break;
 			opt.No_wait = 1;
 			continue;
 		case 's':
@@ -145,6 +277,83 @@ static void parse_opts(int argc, char * argv[])
 			if (opt.Unlink_argfile) break;
 			opt.Unlink_argfile = 1;
 			continue;
+		case XVP_OPT_SPECULATE:
+			if (opt.Speculate || opt.No_wait) break;
+			x = XVP_SPEC_FACTOR_DEFAULT;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if ((x < 2) || (x > XVP_SPEC_FACTOR_MAX)) break;
+			}
+			opt.Speculate = x;
+			continue;
+		case XVP_OPT_STATS:
+			if (opt.Stats) break;
+			x = STDERR_FILENO;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if (x > INT_MAX) break;
+			}
+			opt.Stats = 1;
+			opt.Stats_fd = x;
+			continue;
+		case XVP_OPT_PLAN:
+			if (opt.Plan) break;
+			opt.Plan = 1;
+			continue;
+		case XVP_OPT_TRACE:
+			if (opt.Trace) break;
+			if ((!optarg) || (!*optarg)) break;
+			opt.Trace = 1;
+			opt.Trace_file = optarg;
+			continue;
+		case XVP_OPT_RUSAGE:
+			if (opt.Rusage) break;
+			x = STDERR_FILENO;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if (x > INT_MAX) break;
+			}
+			opt.Rusage = 1;
+			opt.Rusage_fd = x;
+			continue;
+		case XVP_OPT_PERF:
+			if (opt.Perf) break;
+			opt.Perf = 1;
+			continue;
+		case XVP_OPT_UNIQUE:
+		case XVP_OPT_UNIQUE_APPROX:
+			if (opt.Unique) break;
+			x = XVP_UNIQUE_MIB_DEFAULT;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if ((x < 1) || (x > XVP_UNIQUE_MIB_MAX)) break;
+			}
+			opt.Unique = 1;
+			opt.Unique_approx = (o == XVP_OPT_UNIQUE_APPROX);
+			opt.Unique_mib = x;
+			continue;
+		case XVP_OPT_SORT:
+			if (opt.Sort || opt.Locality) break;
+			x = XVP_SORT_MIB_DEFAULT;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if ((x < 1) || (x > XVP_SORT_MIB_MAX)) break;
+			}
+			opt.Sort = 1;
+			opt.Sort_mib = x;
+			continue;
+		case XVP_OPT_LOCALITY:
+		case XVP_OPT_LOCALITY_EXTENT:
+			if (opt.Sort || opt.Locality) break;
+			x = XVP_LOCALITY_WINDOW_DEFAULT;
+			if (optarg) {
+				if (!parse_uint(optarg, &x)) break;
+				if ((x < 2) || (x > XVP_LOCALITY_WINDOW_MAX)) break;
+			}
+			opt.Locality = 1;
+			opt.Locality_extent = (o == XVP_OPT_LOCALITY_EXTENT);
+			opt.Locality_window = x;
+			continue;
 		}
 
 		usage(EINVAL);
@@ -190,19 +399,46 @@ static size_t get_arg_max(void)
 }
 
 static size_t size_env, size_args, argc_max;
-static uvector::str<> argv_init, argv_curr;
+// arguments are byte-packed (as they're laid out by execve(2));
+// small argument lists are stored in-place (no dynamic memory at all)
+#define XVP_ARGV_INIT_INLINE  512
+#define XVP_ARGV_BATCH_INLINE 4096
+
+static uvector::str_compact<unsigned int, MEMFUN_GROWTH_DEFAULT, memfun_allocator, XVP_ARGV_INIT_INLINE> argv_init;
+
+// arguments of current batch are allocated in arena which is reset after each batch
+static arena batch_arena;
+typedef uvector::str_compact<unsigned int, MEMFUN_GROWTH_DEFAULT, arena_allocator<&batch_arena>, XVP_ARGV_BATCH_INLINE> batch_argv;
+static batch_argv argv_curr;
+
+// arguments seen so far ("--unique" and "--unique-approx")
+static uvector::hashset<> unique_set;
+static uvector::bloom<> unique_bloom;
+
+// "--locality": arguments are collected in window and reordered by on-disk location
+// of files (ties keep order of <arg file>)
+static uvector::str_compact<> loc_window;
+
+typedef struct {
+	file_locality key;
+	unsigned int index;
+} loc_item;
+
+static loc_item * loc_items = nullptr;
 
 static struct stat f_stat;
 
 // differs from "findutils" variant
 static constexpr size_t argc_padding = 4;
 
-static size_t get_argv_fullsize(const uvector::str<> * argv)
+template<typename argv_t>
+static size_t get_argv_fullsize(const argv_t * argv)
 {
 	return argv->used() + argv->count() * sizeof(size_t);
 }
 
-static bool is_argv_full(const uvector::str<> * argv) {
+template<typename argv_t>
+static bool is_argv_full(const argv_t * argv) {
 	if (argv->count() > argc_max)
 		return true;
 	if (get_argv_fullsize(argv) > size_args)
@@ -211,7 +447,8 @@ static bool is_argv_full(const uvector::str<> * argv) {
 	return false;
 }
 
-static bool is_argv_full(const uvector::str<> * argv, size_t extra_arg_length) {
+template<typename argv_t>
+static bool is_argv_full(const argv_t * argv, size_t extra_arg_length) {
 	if (argv->count() >= argc_max)
 		return true;
 	if ((get_argv_fullsize(argv) + extra_arg_length + 1) >= size_args)
@@ -229,6 +466,9 @@ static void prepare(int argc, char * argv[])
 		script = "/dev/stdin";
 	}
 
+	// dry run: keep <arg file> as is
+	if (opt.Plan) opt.Unlink_argfile = 0;
+
 	size_env = get_env_size();
 	{
 		size_t x = roundbyl(size_env, memfun_page_default);
@@ -254,6 +494,66 @@ static void prepare(int argc, char * argv[])
 		dump_error(E2BIG, "prepare()");
 		exit(E2BIG);
 	}
+
+	if (opt.Perf && !opt.Stats) {
+		opt.Stats = 1;
+		opt.Stats_fd = STDERR_FILENO;
+	}
+
+	if (opt.Stats && !opt.Info_only) {
+		if (fcntl(opt.Stats_fd, F_GETFD) < 0) {
+			dump_error(errno, "--stats");
+			exit(EBADF);
+		}
+		atexit(stats_dump);
+
+		if (opt.Perf && !perf_open()) {
+			log_stderr("xvp: --perf: no performance counters are available");
+			opt.Perf = 0;
+		}
+	}
+
+	if (opt.Trace && !opt.Info_only) {
+		if (!trace_open(opt.Trace_file)) {
+			dump_path_error(errno, "--trace", opt.Trace_file);
+			exit(errno);
+		}
+		atexit(trace_done);
+	}
+
+	if (opt.Rusage && !opt.Info_only) {
+		if (fcntl(opt.Rusage_fd, F_GETFD) < 0) {
+			dump_error(errno, "--rusage");
+			exit(EBADF);
+		}
+		atexit(rusage_dump);
+	}
+
+	if (opt.Locality && !opt.Info_only) {
+		loc_items = memfun_t_alloc<loc_item>(opt.Locality_window * sizeof(loc_item));
+		if (!loc_items) {
+			dump_error(ENOMEM, "--locality");
+			exit(ENOMEM);
+		}
+	}
+
+	if (opt.Unique && !opt.Info_only) {
+		size_t limit = opt.Unique_mib << 20;
+		if (!opt.Unique_approx) {
+			unique_set.limit(limit);
+		} else if (!unique_bloom.init(limit)) {
+			dump_error(ENOMEM, "--unique-approx");
+			exit(ENOMEM);
+		}
+	}
+
+	// track phases and exec(3) of child processes
+	opt._Track = (opt.Stats || opt.Trace);
+
+	// last batch is to be run as child process if xvp has something to do after it:
+	// - speculation: last batch may be straggler too
+	// - statistics, trace and resource usage: should be written after last batch
+	opt._Fork_last = (opt.Speculate || opt._Track || opt.Rusage);
 }
 
 static void do_exec(void)
@@ -262,6 +562,10 @@ static void do_exec(void)
 
 	argv_init.free();
 
+	// "--speculate": straggler is killed along with its descendants
+	if (opt._Own_pgrp)
+		(void) setpgid(0, 0);
+
 	if (opt._Script_stdin) {
 		int fd_null = open("/dev/null", O_RDONLY);
 		if (fd_null >= 0) {
@@ -284,6 +588,7 @@ static void do_exec(void)
 
 		// execution follows here in case of errors
 		err = errno;
+		USDT_PROBE2(xvp, exec_fail, err, callee);
 
 		if (opt.No_wait) {
 			opt.No_wait = 0;
@@ -329,6 +634,1206 @@ static void delete_script(void)
 	unlink(script);
 }
 
+// log2 histogram (of microseconds)
+#define XVP_HIST_BUCKETS  32
+
+typedef struct {
+	uint64_t count, sum, min, max;
+	uint64_t bucket[XVP_HIST_BUCKETS];
+} xvp_hist;
+
+static void hist_add(xvp_hist * hist, uint64_t nsec)
+{
+	uint64_t x = nsec / MONOTIME_NSEC_PER_USEC;
+	int i = (x) ? getmsbll(x) - 1 : 0;
+	if (i >= XVP_HIST_BUCKETS) i = XVP_HIST_BUCKETS - 1;
+
+	hist->bucket[i]++;
+	if ((!hist->count) || (x < hist->min)) hist->min = x;
+	if (x > hist->max) hist->max = x;
+	hist->sum += x;
+	hist->count++;
+}
+
+enum {
+	XVP_PHASE_OTHER = 0,
+	XVP_PHASE_READ,
+	XVP_PHASE_TOKENIZE,
+	XVP_PHASE_BATCH,
+	XVP_PHASE_SPAWN,
+	XVP_PHASE_WAIT,
+	XVP_PHASE_SORT,
+	XVP_PHASE_LOCALITY,
+	XVP_PHASE_COUNT
+};
+
+static const char * const xvp_phase_name[XVP_PHASE_COUNT] = {
+	"other", "read", "tokenize", "batch", "spawn", "wait", "sort", "locality",
+};
+
+// xvp itself (but not forked child process)
+static pid_t self_pid;
+
+static struct {
+	int phase;
+	uint64_t phase_mark;
+	uint64_t phase_ns[XVP_PHASE_COUNT];
+
+	uint64_t bytes_read, args_parsed, args_dropped, args_repeated;
+	uint64_t sort_runs, sort_spilled;
+	uint64_t locality_windows, locality_keys[FILE_LOCALITY_COUNT];
+	uint64_t batches, batch_args, batch_bytes;
+
+	xvp_hist fork_exec, exec_exit;
+
+	uint64_t perf_mark[PERF_COUNTER_COUNT];
+	uint64_t perf[XVP_PHASE_COUNT][PERF_COUNTER_COUNT];
+} stats;
+
+static perf_counters perf;
+
+static int perf_open(void)
+{
+	return perf_counters_open(&perf);
+}
+
+// trace: "threads" of xvp process
+#define XVP_TRACE_TID_PHASE  1
+#define XVP_TRACE_TID_BATCH  2
+
+static trace_event trace;
+
+static struct {
+	uint64_t batch_mark, batches;
+} tr;
+
+static int trace_open(const char * path)
+{
+	return trace_event_open(&trace, path);
+}
+
+static void trace_start(void)
+{
+	if (!opt.Trace) return;
+
+	trace_event_process_name(&trace, self_pid, "xvp");
+	trace_event_thread_name(&trace, self_pid, XVP_TRACE_TID_PHASE, "phases");
+	trace_event_thread_name(&trace, self_pid, XVP_TRACE_TID_BATCH, "batches");
+}
+
+static void trace_done(void)
+{
+	if (self_pid != getpid()) return;
+
+	trace_event_close(&trace);
+}
+
+static void trace_batch(void)
+{
+	char args[128];
+	uint64_t now = monotime_ns();
+
+	tr.batches++;
+	snprintf(args, sizeof(args), "\"n\":%llu,\"argc\":%u,\"bytes\":%zu",
+		(unsigned long long) tr.batches, argv_curr.count(), get_argv_fullsize(&argv_curr));
+	trace_event_complete(&trace, "batch", "batch", self_pid, XVP_TRACE_TID_BATCH,
+		tr.batch_mark, now - tr.batch_mark, args);
+}
+
+static void trace_exec(pid_t child, uint64_t t_fork, uint64_t t_exec)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "batch #%llu", (unsigned long long) tr.batches);
+	trace_event_process_name(&trace, child, name);
+	trace_event_complete(&trace, "fork", "child", child, child, t_fork, t_exec - t_fork, nullptr);
+}
+
+static void trace_reap(pid_t child, uint64_t t_start, const siginfo_t * child_info)
+{
+	char args[64];
+	uint64_t now = monotime_ns();
+
+	snprintf(args, sizeof(args), "\"si_code\":%d,\"si_status\":%d",
+		child_info->si_code, child_info->si_status);
+	trace_event_complete(&trace, "run", "child", child, child, t_start, now - t_start, nullptr);
+	trace_event_instant(&trace, "reap", "child", child, child, now, args);
+}
+
+static CC_INLINE void phase_switch(int phase)
+{
+	if (!opt._Track) return;
+
+	if (opt.Perf) {
+		uint64_t value[PERF_COUNTER_COUNT];
+		perf_counters_read(&perf, value);
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+			stats.perf[stats.phase][i] += value[i] - stats.perf_mark[i];
+			stats.perf_mark[i] = value[i];
+		}
+	}
+
+	uint64_t now = monotime_ns();
+	if (stats.phase_mark) {
+		stats.phase_ns[stats.phase] += now - stats.phase_mark;
+		if (opt.Trace && (stats.phase != XVP_PHASE_OTHER))
+			trace_event_complete(&trace, xvp_phase_name[stats.phase], "xvp",
+				self_pid, XVP_TRACE_TID_PHASE, stats.phase_mark, now - stats.phase_mark, nullptr);
+	}
+	stats.phase_mark = now;
+	stats.phase = phase;
+}
+
+static void stats_batch(void)
+{
+	if (!opt.Stats) return;
+
+	stats.batches++;
+	stats.batch_args  += argv_curr.count();
+	stats.batch_bytes += get_argv_fullsize(&argv_curr);
+}
+
+static void hist_dump(int fd, const char * name, const xvp_hist * hist)
+{
+	int i, n = 0;
+	for (i = 0; i < XVP_HIST_BUCKETS; i++) {
+		if (hist->bucket[i]) n = i + 1;
+	}
+
+	dprintf(fd, "\"%s\":{\"count\":%llu,\"sum\":%llu,\"min\":%llu,\"max\":%llu,\"log2\":[",
+		name,
+		(unsigned long long) hist->count, (unsigned long long) hist->sum,
+		(unsigned long long) hist->min, (unsigned long long) hist->max);
+	for (i = 0; i < n; i++)
+		dprintf(fd, (i) ? ",%llu" : "%llu", (unsigned long long) hist->bucket[i]);
+	dprintf(fd, "]}");
+}
+
+static void perf_dump(int fd)
+{
+	int i, k, n;
+
+	// counters which don't include kernel
+	dprintf(fd, ",\"perf\":{\"user_only\":[");
+	for (i = 0, n = 0; i < PERF_COUNTER_COUNT; i++) {
+		if ((perf.fd[i] < 0) || (!perf.user_only[i])) continue;
+		dprintf(fd, "%s\"%s\"", (n++) ? "," : "", perf_counter_name[i]);
+	}
+	dprintf(fd, "]");
+
+	for (k = 0; k < XVP_PHASE_COUNT; k++) {
+		dprintf(fd, ",\"%s\":{", xvp_phase_name[k]);
+		for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+			dprintf(fd, "%s\"%s\":", (i) ? "," : "", perf_counter_name[i]);
+			if (perf.fd[i] < 0)
+				dprintf(fd, "null");
+			else
+				dprintf(fd, "%llu", (unsigned long long) stats.perf[k][i]);
+		}
+		dprintf(fd, "}");
+	}
+	dprintf(fd, "}");
+}
+
+static void memfun_stats_dump(int fd)
+{
+	memfun_stats_t m;
+	memfun_stats_get(&m);
+
+	dprintf(fd, ",\"memfun\":{\"allocs\":%zu,\"frees\":%zu"
+		",\"reallocs\":{\"inplace\":%zu,\"moved\":%zu}"
+		",\"bytes\":{\"copied\":%zu,\"zeroed\":%zu,\"live\":%zu,\"peak\":%zu}}",
+		m.allocs, m.frees, m.reallocs_inplace, m.reallocs_moved,
+		m.bytes_copied, m.bytes_zeroed, m.bytes_live, m.bytes_peak);
+}
+
+static void stats_dump(void)
+{
+	// children (i.e. if execvp(3) failed) are not welcome here
+	if (self_pid != getpid()) return;
+
+	phase_switch(XVP_PHASE_OTHER);
+
+	int fd = opt.Stats_fd;
+	double n = (stats.batches) ? (double) stats.batches : 1.0;
+	double avg_args  = (double) stats.batch_args  / n;
+	double avg_bytes = (double) stats.batch_bytes / n;
+
+	dprintf(fd, "{\"bytes_read\":%llu,\"args\":{\"parsed\":%llu,\"dropped\":%llu,\"repeated\":%llu}",
+		(unsigned long long) stats.bytes_read,
+		(unsigned long long) stats.args_parsed, (unsigned long long) stats.args_dropped,
+		(unsigned long long) stats.args_repeated);
+
+	dprintf(fd, ",\"batches\":{\"spawned\":%llu,\"argc_max\":%zu,\"size_args\":%zu"
+		",\"avg_args\":%.3f,\"avg_bytes\":%.3f,\"fill_args\":%.6f,\"fill_bytes\":%.6f}",
+		(unsigned long long) stats.batches, argc_max, size_args,
+		avg_args, avg_bytes, avg_args / (double) argc_max, avg_bytes / (double) size_args);
+
+	dprintf(fd, ",\"time_ns\":{");
+	for (int i = 0; i < XVP_PHASE_COUNT; i++) {
+		dprintf(fd, "%s\"%s\":%llu", (i) ? "," : "",
+			xvp_phase_name[i], (unsigned long long) stats.phase_ns[i]);
+	}
+	dprintf(fd, "}");
+
+	dprintf(fd, ",\"latency_us\":{");
+	hist_dump(fd, "fork_exec", &stats.fork_exec);
+	dprintf(fd, ",");
+	hist_dump(fd, "exec_exit", &stats.exec_exit);
+	dprintf(fd, "}");
+
+	if (opt.Sort)
+		dprintf(fd, ",\"sort\":{\"runs\":%llu,\"bytes_spilled\":%llu}",
+			(unsigned long long) stats.sort_runs, (unsigned long long) stats.sort_spilled);
+
+	if (opt.Locality)
+		dprintf(fd, ",\"locality\":{\"windows\":%llu,\"extent\":%llu,\"inode\":%llu,\"none\":%llu}",
+			(unsigned long long) stats.locality_windows,
+			(unsigned long long) stats.locality_keys[FILE_LOCALITY_EXTENT],
+			(unsigned long long) stats.locality_keys[FILE_LOCALITY_INODE],
+			(unsigned long long) stats.locality_keys[FILE_LOCALITY_NONE]);
+
+	if (opt.Perf) perf_dump(fd);
+	if (MEMFUN_STATS) memfun_stats_dump(fd);
+
+	dprintf(fd, "}\n");
+}
+
+// resource usage of reaped child processes
+typedef struct {
+	uint64_t procs, utime_us, stime_us, maxrss_kb;
+	uint64_t minflt, majflt, inblock, oublock, nvcsw, nivcsw;
+} xvp_rusage;
+
+static struct {
+	xvp_rusage batch, total;
+	uint64_t batches;
+} rus;
+
+static CC_INLINE uint64_t timeval_us(const struct timeval * tv)
+{
+	return ((uint64_t) tv->tv_sec * 1000000ULL) + (uint64_t) tv->tv_usec;
+}
+
+static void rusage_add(xvp_rusage * dst, const struct rusage * ru)
+{
+	dst->procs++;
+	dst->utime_us += timeval_us(&ru->ru_utime);
+	dst->stime_us += timeval_us(&ru->ru_stime);
+	if (dst->maxrss_kb < (uint64_t) ru->ru_maxrss)
+		dst->maxrss_kb = ru->ru_maxrss;
+	dst->minflt  += ru->ru_minflt;
+	dst->majflt  += ru->ru_majflt;
+	dst->inblock += ru->ru_inblock;
+	dst->oublock += ru->ru_oublock;
+	dst->nvcsw   += ru->ru_nvcsw;
+	dst->nivcsw  += ru->ru_nivcsw;
+}
+
+static void rusage_merge(xvp_rusage * dst, const xvp_rusage * src)
+{
+	dst->procs    += src->procs;
+	dst->utime_us += src->utime_us;
+	dst->stime_us += src->stime_us;
+	if (dst->maxrss_kb < src->maxrss_kb)
+		dst->maxrss_kb = src->maxrss_kb;
+	dst->minflt  += src->minflt;
+	dst->majflt  += src->majflt;
+	dst->inblock += src->inblock;
+	dst->oublock += src->oublock;
+	dst->nvcsw   += src->nvcsw;
+	dst->nivcsw  += src->nivcsw;
+}
+
+static void rusage_json(int fd, const char * name, const xvp_rusage * ru)
+{
+	dprintf(fd, "\"%s\":{\"procs\":%llu,\"utime_us\":%llu,\"stime_us\":%llu,\"maxrss_kb\":%llu"
+		",\"minflt\":%llu,\"majflt\":%llu,\"inblock\":%llu,\"oublock\":%llu"
+		",\"nvcsw\":%llu,\"nivcsw\":%llu}",
+		name,
+		(unsigned long long) ru->procs,
+		(unsigned long long) ru->utime_us, (unsigned long long) ru->stime_us,
+		(unsigned long long) ru->maxrss_kb,
+		(unsigned long long) ru->minflt, (unsigned long long) ru->majflt,
+		(unsigned long long) ru->inblock, (unsigned long long) ru->oublock,
+		(unsigned long long) ru->nvcsw, (unsigned long long) ru->nivcsw);
+}
+
+// batch (and its speculative duplicate, if any) is done
+static void rusage_batch(size_t n_args, size_t n_bytes, uint64_t wall_ns)
+{
+	rus.batches++;
+
+	// with "-n" only total is written (see rusage_dump())
+	if (opt.No_wait) {
+		(void) memset(&rus.batch, 0, sizeof(rus.batch));
+		return;
+	}
+
+	rusage_merge(&rus.total, &rus.batch);
+
+	dprintf(opt.Rusage_fd, "{\"batch\":%llu,\"args\":%zu,\"bytes\":%zu,\"wall_us\":%llu,",
+		(unsigned long long) rus.batches, n_args, n_bytes,
+		(unsigned long long) (wall_ns / MONOTIME_NSEC_PER_USEC));
+	rusage_json(opt.Rusage_fd, "rusage", &rus.batch);
+	dprintf(opt.Rusage_fd, "}\n");
+
+	(void) memset(&rus.batch, 0, sizeof(rus.batch));
+}
+
+static void rusage_dump(void)
+{
+	if (self_pid != getpid()) return;
+
+	// children weren't waited one by one;
+	// RUSAGE_CHILDREN counts only reaped ones: last batch and those of earlier ones
+	// which were reaped in passing (see batch_spawn()), so total is lower bound
+	if (opt.No_wait) {
+		struct rusage ru;
+		if (0 == getrusage(RUSAGE_CHILDREN, &ru)) {
+			(void) memset(&rus.total, 0, sizeof(rus.total));
+			rusage_add(&rus.total, &ru);
+			rus.total.procs = 0;
+		}
+	}
+
+	dprintf(opt.Rusage_fd, "{\"batches\":%llu,", (unsigned long long) rus.batches);
+	rusage_json(opt.Rusage_fd, "total", &rus.total);
+	dprintf(opt.Rusage_fd, "}\n");
+}
+
+// waitid(2) which also reports resource usage of gone child process;
+// glibc wrapper doesn't expose last argument of system call
+static int xvp_waitid(idtype_t idtype, id_t id, siginfo_t * info, int options, struct rusage * ru)
+{
+	if (!ru)
+		return waitid(idtype, id, info, options);
+
+	(void) memset(ru, 0, sizeof(*ru));
+	return syscall(SYS_waitid, idtype, id, info, options, ru);
+}
+
+static int argv_refine(int * err)
+{
+	argv_curr.free();
+	arena_reset(&batch_arena);
+	argv_curr.append(argv_init);
+	if (argv_curr.count() == argv_init.count()) {
+		if (opt.Trace) tr.batch_mark = monotime_ns();
+		return 0;
+	}
+
+	*err = errno;
+	if (!*err) *err = ENOMEM;
+	return 1;
+}
+
+/* returns:
+ *   0 - child process is still alive (stopped or continued)
+ *   1 - child process is gone
+ *  -1 - child process is gone and xvp should stop (strict mode)
+ */
+static int child_state(pid_t child, const siginfo_t * child_info, int * err)
+{
+	if (!opt.Strict) {
+		switch (child_info->si_code) {
+		case CLD_EXITED:
+			*err = child_info->si_status;
+			break;
+		case CLD_KILLED:
+			// -fallthrough
+		case CLD_DUMPED:
+			// same as shell does
+			*err = 128 + child_info->si_status;
+			break;
+		}
+
+		switch (child_info->si_code) {
+		case CLD_STOPPED:
+			// -fallthrough
+		case CLD_CONTINUED:
+			return 0;
+		case CLD_EXITED:
+			// -fallthrough
+		case CLD_KILLED:
+			// -fallthrough
+		case CLD_DUMPED:
+			// -fallthrough
+		case CLD_TRAPPED:
+			return 1;
+		default:
+			log_stderr("xvp: child process %d has been turned into unknown state (siginfo_t.si_code=%d)", child, child_info->si_code);
+			return 1;
+		}
+	}
+
+	switch (child_info->si_code) {
+	case CLD_STOPPED:
+		log_stderr("xvp: child process %d has been stopped", child);
+		return 0;
+	case CLD_CONTINUED:
+		log_stderr("xvp: child process %d has been continued", child);
+		return 0;
+	case CLD_EXITED:
+		*err = child_info->si_status;
+		if (*err == 0) return 1;
+		log_stderr("xvp: child process %d has exited with non-null return code: %d", child, *err);
+		return -1;
+	case CLD_KILLED:
+		*err = 128 + child_info->si_status;
+		log_stderr("xvp: child process %d has been killed by signal %d", child, child_info->si_status);
+		return -1;
+	case CLD_DUMPED:
+		*err = 128 + child_info->si_status;
+		log_stderr("xvp: child process %d has been dumped by signal %d", child, child_info->si_status);
+		return -1;
+	case CLD_TRAPPED:
+		log_stderr("xvp: child process %d has been trapped by signal %d", child, child_info->si_status);
+		return -1;
+	default:
+		log_stderr("xvp: child process %d has been turned into unknown state (siginfo_t.si_code=%d)", child, child_info->si_code);
+		return -1;
+	}
+}
+
+// current batch process and its (speculative) duplicate
+static struct {
+	pid_t child, dup;
+	uint64_t t_fork, t_exec, t_dup;
+} spawn;
+
+// signal process group of batch process (or at least process itself)
+static void spec_kill(pid_t pid, int sig)
+{
+	if (opt._Own_pgrp && (kill(-pid, sig) == 0)) return;
+	(void) kill(pid, sig);
+}
+
+// "--speculate": batch and its duplicate are leaders of their own process groups,
+// so signals from terminal are forwarded to them
+static void spec_forward(int sig)
+{
+	if (spawn.child > 0) spec_kill(spawn.child, sig);
+	if (spawn.dup > 0)   spec_kill(spawn.dup, sig);
+
+	(void) signal(sig, SIG_DFL);
+	(void) raise(sig);
+}
+
+static void spec_signals(void)
+{
+	static const int sigs[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM };
+
+	struct sigaction sa;
+	(void) memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = spec_forward;
+	(void) sigemptyset(&sa.sa_mask);
+	for (auto sig : sigs)
+		(void) sigaction(sig, &sa, nullptr);
+}
+
+// child process is gone
+static void on_reap(pid_t child, const siginfo_t * child_info, const struct rusage * ru)
+{
+	USDT_PROBE3(xvp, reap, child, child_info->si_code, child_info->si_status);
+
+	if (ru) rusage_add(&rus.batch, ru);
+
+	if (opt.Trace)
+		trace_reap(child, (child == spawn.child) ? spawn.t_exec : spawn.t_dup, child_info);
+}
+
+static int wait_child(pid_t child, int * err)
+{
+	siginfo_t child_info;
+	struct rusage ru_buf, * ru = (opt.Rusage) ? &ru_buf : nullptr;
+
+	*err = ECHILD;
+
+	for (;;) {
+		usleep(1);
+		(void) memset(&child_info, 0, sizeof(child_info));
+		if (0 != xvp_waitid(P_PID, child, &child_info, WEXITED | WSTOPPED | WCONTINUED, ru))
+			return 0;
+
+		switch (child_state(child, &child_info, err)) {
+		case 0:
+			continue;
+		case 1:
+			on_reap(child, &child_info, ru);
+			return 0;
+		default:
+			on_reap(child, &child_info, ru);
+			return 1;
+		}
+	}
+}
+
+static struct {
+	uint64_t runtime[XVP_SPEC_WINDOW];
+	unsigned int count;
+} spec;
+
+static void spec_record(uint64_t runtime)
+{
+	spec.runtime[spec.count % XVP_SPEC_WINDOW] = runtime;
+	spec.count++;
+	// keep index from wrapping into "not enough samples"
+	if (spec.count >= (2 * XVP_SPEC_WINDOW))
+		spec.count -= XVP_SPEC_WINDOW;
+}
+
+// returns time mark when batch started at "start" is considered to be straggler or 0
+static uint64_t spec_deadline(uint64_t start)
+{
+	if (spec.count < XVP_SPEC_SAMPLES_MIN) return 0;
+
+	uint64_t r[XVP_SPEC_WINDOW], x;
+	unsigned int i, k, n = min(spec.count, XVP_SPEC_WINDOW);
+	(void) memcpy(r, spec.runtime, n * sizeof(r[0]));
+
+	// window is small enough for insertion sort
+	for (i = 1; i < n; i++) {
+		x = r[i];
+		for (k = i; (k > 0) && (r[k - 1] > x); k--)
+			r[k] = r[k - 1];
+		r[k] = x;
+	}
+
+	x = r[n / 2] * opt.Speculate;
+	if (x < XVP_SPEC_NSEC_MIN) x = XVP_SPEC_NSEC_MIN;
+
+	return start + x;
+}
+
+// wait for either batch process or its duplicate (if any)
+static int wait_child_spec(pid_t child, uint64_t start, int * err)
+{
+	siginfo_t child_info;
+	struct rusage ru_buf, * ru = (opt.Rusage) ? &ru_buf : nullptr;
+	pid_t dup = 0, loser;
+	uint64_t dup_start = 0, now;
+	uint64_t deadline = spec_deadline(start);
+	useconds_t nap = 1;
+	int r;
+
+	*err = ECHILD;
+
+	for (;;) {
+		(void) memset(&child_info, 0, sizeof(child_info));
+		r = WEXITED | WSTOPPED | WCONTINUED;
+		if (deadline && !dup) r |= WNOHANG;
+		if (0 != xvp_waitid(P_ALL, 0, &child_info, r, ru))
+			return 0;
+
+		if (child_info.si_pid == 0) {
+			if (monotime_ns() < deadline) {
+				usleep(nap);
+				if (nap < 1024) nap <<= 1;
+				continue;
+			}
+
+			// straggler: try to run duplicate
+			dup_start = monotime_ns();
+			dup = fork();
+			if (dup == 0) do_exec();
+			if (dup == -1) {
+				// don't try again
+				dup = 0;
+				deadline = 0;
+				continue;
+			}
+			// same as child does (whichever is first)
+			if (opt._Own_pgrp)
+				(void) setpgid(dup, dup);
+			USDT_PROBE2(xvp, fork, dup, argv_curr.count());
+			spawn.dup = dup;
+			spawn.t_dup = dup_start;
+			if (opt.Trace)
+				trace_event_instant(&trace, "speculate", "child", dup, dup, dup_start, nullptr);
+			continue;
+		}
+
+		if ((child_info.si_pid != child) && (child_info.si_pid != dup))
+			continue;
+
+		if ((child_info.si_code == CLD_STOPPED) || (child_info.si_code == CLD_CONTINUED)) {
+			(void) child_state(child_info.si_pid, &child_info, err);
+			// process group is not foreground one so nobody would continue it
+			if (opt._Own_pgrp && (child_info.si_code == CLD_STOPPED)
+			 && ((child_info.si_status == SIGTTIN) || (child_info.si_status == SIGTTOU))) {
+				log_stderr("xvp: child process %d has been stopped by terminal access (killing it)", child_info.si_pid);
+				spec_kill(child_info.si_pid, SIGKILL);
+			}
+			continue;
+		}
+
+		now = monotime_ns();
+		if (child_info.si_pid == child) {
+			loser = dup;
+			spec_record(now - start);
+		} else {
+			loser = child;
+			child = dup;
+			spec_record(now - dup_start);
+		}
+
+		on_reap(child_info.si_pid, &child_info, ru);
+
+		if (loser) {
+			siginfo_t loser_info;
+			// kill whole process group (or at least process itself)
+			spec_kill(loser, SIGKILL);
+			(void) memset(&loser_info, 0, sizeof(loser_info));
+			if (0 == xvp_waitid(P_PID, loser, &loser_info, WEXITED, ru))
+				on_reap(loser, &loser_info, ru);
+		}
+
+		return (child_state(child, &child_info, err) < 0) ? 1 : 0;
+	}
+}
+
+static struct {
+	uint64_t batches, pushed, dropped, repeated;
+} plan;
+
+static void plan_batch(void)
+{
+	size_t n_args = argv_curr.count() - argv_init.count();
+	size_t n_bytes = get_argv_fullsize(&argv_curr);
+
+	plan.batches++;
+
+	printf("batch\t%llu\t%zu\t%zu\t%.6f\t%.6f\n",
+		(unsigned long long) plan.batches, n_args, n_bytes,
+		(double) argv_curr.count() / (double) argc_max,
+		(double) n_bytes / (double) size_args);
+}
+
+// "index" is index of argument in <arg file>
+static void plan_dropped(uint64_t index, size_t length)
+{
+	printf("skip\t%llu\t%zu\n", (unsigned long long) index, length);
+	plan.dropped++;
+}
+
+static void plan_repeated(uint64_t index, size_t length)
+{
+	printf("dup\t%llu\t%zu\n", (unsigned long long) index, length);
+	plan.repeated++;
+}
+
+static void plan_summary(void)
+{
+	printf("total\t%llu\t%llu\t%llu\t%llu\n",
+		(unsigned long long) plan.batches,
+		(unsigned long long) plan.pushed, (unsigned long long) plan.dropped,
+		(unsigned long long) plan.repeated);
+}
+
+// wait for execve(2) in child process: write end of pipe is closed on exec
+static void wait_exec(int fd)
+{
+	char c;
+	while (read(fd, &c, sizeof(c)) < 0) {
+		if (errno != EINTR) break;
+	}
+	close(fd);
+}
+
+// "last": batch is run as child process instead of exec(3) (see opt._Fork_last)
+static int batch_spawn(int last, int * err)
+{
+	if (argv_curr.count() == argv_init.count()) return 0;
+
+	stats_batch();
+	if (opt.Trace) trace_batch();
+
+	if (opt.Plan) {
+		plan_batch();
+		return 0;
+	}
+
+	int fd_exec[2] = { -1, -1 };
+	uint64_t start = 0, t_exec;
+	int r;
+
+	phase_switch(XVP_PHASE_SPAWN);
+
+	if (opt._Track) {
+		if (pipe2(fd_exec, O_CLOEXEC) < 0)
+			fd_exec[0] = fd_exec[1] = -1;
+	}
+
+	if (opt.Speculate || opt._Track || opt.Rusage)
+		start = monotime_ns();
+
+	pid_t child = fork();
+	if (child == 0) do_exec();
+	if (child == -1) {
+		*err = errno;
+		if (!*err) *err = ENOMEM;
+		return 1;
+	}
+
+	USDT_PROBE2(xvp, fork, child, argv_curr.count());
+
+	// same as child does (whichever is first)
+	if (opt._Own_pgrp)
+		(void) setpgid(child, child);
+
+	t_exec = start;
+	if (fd_exec[0] >= 0) {
+		close(fd_exec[1]);
+		wait_exec(fd_exec[0]);
+		t_exec = monotime_ns();
+		hist_add(&stats.fork_exec, t_exec - start);
+		if (opt.Trace) trace_exec(child, start, t_exec);
+	}
+
+	spawn.child  = child;
+	spawn.dup    = 0;
+	spawn.t_fork = start;
+	spawn.t_exec = t_exec;
+
+	phase_switch(XVP_PHASE_WAIT);
+
+	// with "-n" only last batch is waited for: its exit code is exit code of xvp
+	if (opt.No_wait && !last) {
+		(void) waitpid(-1, nullptr, WNOHANG);
+		if (opt.Rusage) rus.batches++;
+		return 0;
+	}
+
+	if (opt.Speculate)
+		r = wait_child_spec(child, start, err);
+	else
+		r = wait_child(child, err);
+
+	if (opt.Stats)
+		hist_add(&stats.exec_exit, monotime_ns() - t_exec);
+
+	if (opt.Rusage)
+		rusage_batch(argv_curr.count() - argv_init.count(), get_argv_fullsize(&argv_curr), monotime_ns() - start);
+
+	return r;
+}
+
+static int batch_flush(int * err)
+{
+	if (opt.Force_once) {
+		*err = E2BIG;
+		return 1;
+	}
+
+	// batches are flushed while tokenizing (or merging sorted runs)
+	int phase = stats.phase;
+
+	if (batch_spawn(0, err)) return 1;
+
+	phase_switch(XVP_PHASE_BATCH);
+
+	// do rest of work
+	int r = argv_refine(err);
+
+	phase_switch(phase);
+	return r;
+}
+
+static int batch_push(const char * arg, size_t length, int * err)
+{
+	if (is_argv_full(&argv_curr, length)) {
+		USDT_PROBE2(xvp, batch_full, argv_curr.count(), get_argv_fullsize(&argv_curr));
+		if (batch_flush(err)) return 1;
+	}
+
+	uint32_t arg_idx = argv_curr.append(arg, length);
+	if (batch_argv::is_inv(arg_idx)) {
+		*err = errno;
+		if (!*err) *err = ENOMEM;
+		return 1;
+	}
+
+	USDT_PROBE2(xvp, arg_parsed, length, argv_curr.count());
+
+	if (opt.Stats) stats.args_parsed++;
+	if (opt.Plan) plan.pushed++;
+
+	if (is_argv_full(&argv_curr, 0)) {
+		USDT_PROBE2(xvp, batch_full, argv_curr.count(), get_argv_fullsize(&argv_curr));
+		return batch_flush(err);
+	}
+
+	return 0;
+}
+
+// "--sort": arguments are collected in run buffer and sorted;
+// runs which exceed memory budget are spilled to (unnamed) temporary files
+// and merged at the end of <arg file>
+static uvector::str_compact<> sort_run;
+static uvector::sort_item * sort_items = nullptr;
+static size_t sort_items_size = 0;
+static uvector::dynmem<int, unsigned int> sort_files;
+static char * sort_wbuf = nullptr;
+
+// merge: spilled run is read with its own buffer
+typedef struct {
+	int fd, eof;
+	size_t size, used, pos;
+	char * buf;
+	uvector::str_view head;
+} sort_reader;
+
+static int sort_tmpfile(void)
+{
+	const char * dir = getenv("TMPDIR");
+	if ((!dir) || (!*dir)) dir = "/tmp";
+
+	int fd;
+#ifdef O_TMPFILE
+	fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (fd >= 0) return fd;
+#endif
+
+	// file system doesn't support O_TMPFILE: file is unlinked right after creation
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s/xvp.sort.XXXXXX", dir) >= (int) sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fd = mkostemp(path, O_CLOEXEC);
+	if (fd < 0) return -1;
+
+	(void) unlink(path);
+	return fd;
+}
+
+static int write_all(int fd, const char * buf, size_t length)
+{
+	size_t x = 0;
+	while (x < length) {
+		ssize_t r = write(fd, buf + x, length - x);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			return 0;
+		}
+		x += r;
+	}
+	return 1;
+}
+
+// sort current run (into "sort_items")
+static int sort_order(int * err)
+{
+	size_t need = (size_t) sort_run.count() * sizeof(uvector::sort_item);
+	if (need > sort_items_size) {
+		size_t len = sort_items_size;
+		sort_items = memfun_t_realloc_policy(sort_items, &len, need - sort_items_size, MEMFUN_GROWTH_DEFAULT);
+		if (len < need) {
+			*err = ENOMEM;
+			return 1;
+		}
+		sort_items_size = len;
+	}
+
+	uvector::sort_views(sort_run, sort_items);
+	return 0;
+}
+
+// write sorted run to temporary file
+static int sort_spill(int * err)
+{
+	if (!sort_run.count()) return 0;
+
+	if (sort_order(err)) return 1;
+
+	if (!sort_wbuf) {
+		sort_wbuf = memfun_t_alloc<char>(XVP_SORT_WBUF);
+		if (!sort_wbuf) {
+			*err = ENOMEM;
+			return 1;
+		}
+	}
+
+	int fd = sort_tmpfile();
+	if (fd < 0) {
+		*err = errno;
+		dump_error(*err, "--sort: temporary file");
+		return 1;
+	}
+	if (sort_files.is_inv(sort_files.append(fd))) {
+		close(fd);
+		*err = ENOMEM;
+		return 1;
+	}
+
+	size_t n = 0;
+	const unsigned int count = sort_run.count();
+	for (unsigned int i = 0; i < count; i++) {
+		const uvector::str_view & v = sort_items[i].view;
+
+		if ((n + v.length + 1) > XVP_SORT_WBUF) {
+			if (!write_all(fd, sort_wbuf, n)) goto _spill_err;
+			n = 0;
+		}
+
+		// string in pool is terminated so it may be written as is
+		if ((v.length + 1) > XVP_SORT_WBUF) {
+			if (!write_all(fd, v.ptr, v.length + 1)) goto _spill_err;
+			continue;
+		}
+
+		(void) memcpy(sort_wbuf + n, v.ptr, v.length);
+		sort_wbuf[n + v.length] = 0;
+		n += v.length + 1;
+	}
+	if (!write_all(fd, sort_wbuf, n)) goto _spill_err;
+
+	if (opt.Stats) {
+		stats.sort_runs++;
+		stats.sort_spilled += sort_run.used();
+	}
+
+	sort_run.free();
+	return 0;
+
+_spill_err:
+	*err = errno;
+	dump_error(*err, "--sort: write(2)");
+	return 1;
+}
+
+static int sort_push(const char * arg, size_t length, int * err)
+{
+	if (sort_run.is_inv(sort_run.append(arg, length))) {
+		*err = errno;
+		if (!*err) *err = ENOMEM;
+		return 1;
+	}
+
+	// pool, its offsets and sort items
+	size_t x = sort_run.used() + (size_t) sort_run.count() * (sizeof(uint32_t) + sizeof(uvector::sort_item));
+	if (x < (opt.Sort_mib << 20)) return 0;
+
+	phase_switch(XVP_PHASE_SORT);
+	int r = sort_spill(err);
+	phase_switch(XVP_PHASE_TOKENIZE);
+	return r;
+}
+
+// returns 1 if next argument is read, 0 at end of run or -1 on error
+static int sort_reader_next(sort_reader * r)
+{
+	for (;;) {
+		char * p = r->buf + r->pos;
+		size_t avail = r->used - r->pos;
+
+		auto z = (char *) memchr(p, 0, avail);
+		if (z) {
+			r->head = { p, (size_t) (z - p) };
+			r->pos += r->head.length + 1;
+			return 1;
+		}
+
+		if (r->eof) return 0;
+
+		// previous argument is already consumed
+		if (r->pos) {
+			(void) memmove(r->buf, p, avail);
+			r->used = avail;
+			r->pos = 0;
+		}
+
+		ssize_t n = read(r->fd, r->buf + r->used, r->size - r->used);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (n == 0) r->eof = 1;
+		r->used += n;
+	}
+}
+
+static void sort_heap_down(const sort_reader * readers, unsigned int * heap, unsigned int n, unsigned int i)
+{
+	for (;;) {
+		unsigned int m = i, l = (2 * i) + 1, r = l + 1;
+		if ((l < n) && (uvector::sort_compare(readers[heap[l]].head, readers[heap[m]].head) < 0)) m = l;
+		if ((r < n) && (uvector::sort_compare(readers[heap[r]].head, readers[heap[m]].head) < 0)) m = r;
+		if (m == i) return;
+
+		unsigned int t = heap[i];
+		heap[i] = heap[m];
+		heap[m] = t;
+		i = m;
+	}
+}
+
+// k-way merge of spilled runs; "s_buf" should hold longest argument (with terminator)
+// (reader's buffer may be larger: it's whole allocated length)
+static int sort_merge(size_t s_buf, int * err)
+{
+	const unsigned int k = sort_files.count();
+	// allocated lengths are kept for memfun_t_free()
+	size_t readers_len = k * sizeof(sort_reader), heap_len = k * sizeof(unsigned int);
+	auto readers = memfun_t_alloc_ex<sort_reader>(&readers_len);
+	auto heap = memfun_t_alloc_ex<unsigned int>(&heap_len);
+	if ((!readers) || (!heap)) {
+		*err = ENOMEM;
+		return 1;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < k; i++) {
+		sort_reader * r = &readers[i];
+		(void) memset(r, 0, sizeof(*r));
+		r->fd = sort_files.get_val(i);
+		r->size = s_buf;
+		r->buf = memfun_t_alloc_ex<char>(&(r->size));
+		if (!r->buf) {
+			*err = ENOMEM;
+			return 1;
+		}
+
+		if (lseek(r->fd, 0, SEEK_SET) < 0) goto _merge_err;
+
+		switch (sort_reader_next(r)) {
+		case 1:  heap[n++] = i; break;
+		case 0:  break;
+		default: goto _merge_err;
+		}
+	}
+
+	for (unsigned int i = n / 2; (i--) != 0; )
+		sort_heap_down(readers, heap, n, i);
+
+	while (n) {
+		sort_reader * r = &readers[heap[0]];
+		if (batch_push(r->head.ptr, r->head.length, err)) return 1;
+
+		switch (sort_reader_next(r)) {
+		case 1:  break;
+		case 0:  heap[0] = heap[--n]; break;
+		default: goto _merge_err;
+		}
+		sort_heap_down(readers, heap, n, 0);
+	}
+
+	for (unsigned int i = 0; i < k; i++) {
+		close(readers[i].fd);
+		memfun_t_free(readers[i].buf, readers[i].size);
+	}
+	sort_files.free();
+	memfun_t_free(readers, readers_len);
+	memfun_t_free(heap, heap_len);
+	return 0;
+
+_merge_err:
+	*err = errno;
+	dump_error(*err, "--sort: read(2)");
+	return 1;
+}
+
+// end of <arg file>: push sorted arguments to batches
+static int sort_finish(size_t s_buf, int * err)
+{
+	phase_switch(XVP_PHASE_SORT);
+
+	int r = 0;
+	if (sort_files.count()) {
+		r = sort_spill(err);
+		if (!r) r = sort_merge(s_buf, err);
+	} else if (sort_run.count()) {
+		r = sort_order(err);
+		const unsigned int count = sort_run.count();
+		for (unsigned int i = 0; (!r) && (i < count); i++)
+			r = batch_push(sort_items[i].view.ptr, sort_items[i].view.length, err);
+		sort_run.free();
+	}
+
+	phase_switch(XVP_PHASE_OTHER);
+	return r;
+}
+
+static int loc_item_compare(const void * p1, const void * p2)
+{
+	auto a = (const loc_item *) p1;
+	auto b = (const loc_item *) p2;
+
+	int r = file_locality_compare(&(a->key), &(b->key));
+	if (r) return r;
+
+	return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+static int loc_flush(int * err)
+{
+	const unsigned int count = loc_window.count();
+	if (!count) return 0;
+
+	int phase = stats.phase;
+	phase_switch(XVP_PHASE_LOCALITY);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int kind = file_locality_get(loc_window.get(i), opt.Locality_extent, &(loc_items[i].key));
+		loc_items[i].index = i;
+		if (opt.Stats) stats.locality_keys[kind]++;
+	}
+
+	qsort(loc_items, count, sizeof(loc_item), loc_item_compare);
+
+	if (opt.Stats) stats.locality_windows++;
+
+	phase_switch(phase);
+
+	for (unsigned int i = 0; i < count; i++) {
+		uvector::str_view v = loc_window.get_view(loc_items[i].index);
+		if (batch_push(v.ptr, v.length, err)) return 1;
+	}
+
+	loc_window.free();
+	return 0;
+}
+
+static int loc_push(const char * arg, size_t length, int * err)
+{
+	if (loc_window.is_inv(loc_window.append(arg, length))) {
+		*err = errno;
+		if (!*err) *err = ENOMEM;
+		return 1;
+	}
+
+	if (loc_window.count() < opt.Locality_window) return 0;
+
+	return loc_flush(err);
+}
+
+static int arg_push(const char * arg, size_t length, int * err)
+{
+	if (opt.Sort) return sort_push(arg, length, err);
+	if (opt.Locality) return loc_push(arg, length, err);
+
+	return batch_push(arg, length, err);
+}
+
+// returns non-zero if argument was seen before (and is to be skipped)
+static int unique_seen(const char * arg, size_t length)
+{
+	if (opt.Unique_approx)
+		return !unique_bloom.insert(arg, length);
+
+	int r = unique_set.insert(arg, length);
+	if (r >= 0) return (r == 0);
+
+	// set is full: argument is passed but not remembered
+	static int warned = 0;
+	if (!warned) {
+		warned = 1;
+		log_stderr("xvp: --unique: memory limit is reached (%zu MiB), new arguments are not tracked anymore", opt.Unique_mib);
+	}
+	return 0;
+}
+
 static void run(void)
 {
 	size_t s_buf_arg  = 32 * memfun_page_size();
@@ -352,11 +1857,10 @@ static void run(void)
 	struct stat tmp_stat;
 
 	size_t n_buf = 0, total = 0, block;
+	// index of argument in <arg file> (for "--plan")
+	uint64_t n_arg = 0;
 	ssize_t n_read = 0;
 	char * tbuf = nullptr;
-	uint32_t arg_idx;
-	int arg_pend = 0, exec_ready = 0;
-	pid_t child;
 	siginfo_t child_info;
 
 	size_t s_buf_read = s_buf_arg + memfun_page_size(); // s_buf_arg + one extra page
@@ -368,13 +1872,19 @@ static void run(void)
 		goto _run_err;
 	}
 
-	argv_curr.free();
-	argv_curr.append(argv_init);
-	if (!argv_curr.allocated()) {
-		err = errno;
-		if (!err) err = ENOMEM;
+	if (argv_refine(&err))
 		goto _run_err;
-	}
+
+	self_pid = getpid();
+	trace_start();
+	phase_switch(XVP_PHASE_OTHER);
+
+	if (opt.Plan)
+		printf("# batch\t<n>\t<args>\t<bytes>\t<fill args>\t<fill bytes>\n"
+		       "# skip\t<arg index>\t<length>\n"
+		       "# total\t<batches>\t<args>\t<skipped>\t<repeated>\n");
+	if (opt.Plan && opt.Unique)
+		printf("# dup\t<arg index>\t<length>\n");
 
 	if (opt._Script_stdin) {
 		fd = 0;
@@ -411,27 +1921,22 @@ static void run(void)
 		fd = 0;
 	}
 
-	(void) memset(buf_arg, 0, s_buf_arg);
+	// "--speculate": batches run in their own process groups unless they may read terminal
+	// (process which reads terminal outside of foreground process group is stopped)
+	opt._Own_pgrp = (opt.Speculate && !opt.Plan && (opt._Script_stdin || !isatty(0)));
+	if (opt._Own_pgrp)
+		spec_signals();
 
+	// buffers are not cleared: arguments are delimited with strnlen(3)
+	// and passed with explicit length
 	for (;;) {
-		if (arg_pend) {
-			arg_idx = argv_curr.append(buf_arg, total);
-			if (uvector::str<>::is_inv(arg_idx)) {
-				err = errno;
-				if (!err) err = ENOMEM;
-				goto _run_out;
-			}
-
-			total = 0;
-			arg_pend = 0;
-			(void) memset(buf_arg, 0, s_buf_arg);
-		}
-
 		if (!n_buf) {
-			(void) memset(buf_read, 0, s_buf_read);
+			phase_switch(XVP_PHASE_READ);
 			n_read = read(fd, buf_read, s_buf_read);
 			if (n_read > 0) n_buf = (size_t) n_read;
 			tbuf = buf_read;
+			phase_switch(XVP_PHASE_TOKENIZE);
+			if (opt.Stats) stats.bytes_read += n_buf;
 		}
 
 		while (n_buf > 0) {
@@ -446,8 +1951,13 @@ static void run(void)
 
 				block++; n_buf -= block; tbuf += block;
 
+				USDT_PROBE1(xvp, arg_dropped, total);
+
+				if (opt.Stats) stats.args_dropped++;
+				if (opt.Plan) plan_dropped(n_arg, total);
+				n_arg++;
+
 				total = 0;
-				(void) memset(buf_arg, 0, s_buf_arg);
 
 				continue;
 			}
@@ -461,135 +1971,49 @@ static void run(void)
 
 			block++; n_buf -= block; tbuf += block;
 
-			if (is_argv_full(&argv_curr, total)) {
-				exec_ready = 1;
-				arg_pend = 1;
-				break;
-			}
+			if (opt.Unique && unique_seen(buf_arg, total)) {
+				USDT_PROBE1(xvp, arg_repeated, total);
 
-			arg_idx = argv_curr.append(buf_arg, total);
-			if (uvector::str<>::is_inv(arg_idx)) {
-				err = errno;
-				if (!err) err = ENOMEM;
+				if (opt.Stats) stats.args_repeated++;
+				if (opt.Plan) plan_repeated(n_arg, total);
+			} else if (arg_push(buf_arg, total, &err))
 				goto _run_out;
-			}
 
+			n_arg++;
 			total = 0;
-			(void) memset(buf_arg, 0, s_buf_arg);
-
-			if (is_argv_full(&argv_curr, 0)) {
-				exec_ready = 1;
-				break;
-			}
 		}
 
 		if (n_read <= 0) break;
+	}
 
-		if (!exec_ready) continue;
-
-		if (opt.Force_once) {
-			err = E2BIG;
-			goto _run_out;
-		}
-
-		child = fork();
-		if (child == 0) do_exec();
-		if (child == -1) {
-			err = errno;
-			if (!err) err = ENOMEM;
-			goto _run_out;
-		}
-
-		(void) waitpid(-1, nullptr, WNOHANG);
-
-		if (!opt.No_wait) {
-			err = ECHILD;
+	close(fd); fd = -1;
 
-			// wait for child
-			do {
-				usleep(1);
-				(void) memset(&child_info, 0, sizeof(child_info));
-				if (0 != waitid(P_PID, child, &child_info, WEXITED | WSTOPPED | WCONTINUED)) {
-					break;
-				}
+	delete_script();
 
-				if (!opt.Strict) {
-					if (child_info.si_code == CLD_EXITED)
-						err = child_info.si_status;
-
-					switch (child_info.si_code) {
-					case CLD_STOPPED:
-						// -fallthrough
-					case CLD_CONTINUED:
-						break;
-					case CLD_EXITED:
-						// -fallthrough
-					case CLD_KILLED:
-						// -fallthrough
-					case CLD_DUMPED:
-						// -fallthrough
-					case CLD_TRAPPED:
-						child = 0;
-						break;
-					default:
-						log_stderr("xvp: child process %d has been turned into unknown state (siginfo_t.si_code=%d)", child, child_info.si_code);
-						child = 0;
-						break;
-					}
-				} else {
-					switch (child_info.si_code) {
-					case CLD_STOPPED:
-						log_stderr("xvp: child process %d has been stopped", child);
-						break;
-					case CLD_CONTINUED:
-						log_stderr("xvp: child process %d has been continued", child);
-						break;
-					case CLD_EXITED:
-						err = child_info.si_status;
-						if (err == 0) {
-							child = 0;
-							break;
-						}
-						log_stderr("xvp: child process %d has exited with non-null return code: %d", child, err);
-						goto _run_out;
-					case CLD_KILLED:
-						log_stderr("xvp: child process %d has been killed by signal %d", child, child_info.si_status);
-						goto _run_out;
-					case CLD_DUMPED:
-						log_stderr("xvp: child process %d has been dumped by signal %d", child, child_info.si_status);
-						goto _run_out;
-					case CLD_TRAPPED:
-						log_stderr("xvp: child process %d has been trapped by signal %d", child, child_info.si_status);
-						goto _run_out;
-					default:
-						log_stderr("xvp: child process %d has been turned into unknown state (siginfo_t.si_code=%d)", child, child_info.si_code);
-						goto _run_out;
-					}
-				}
-			} while (child);
-		}
+	if (opt.Sort && sort_finish(s_buf_read, &err))
+		goto _run_out;
 
-		// do rest of work
-		exec_ready = 0;
+	if (opt.Locality && loc_flush(&err))
+		goto _run_out;
 
-		// refine current argv
-		argv_curr.free();
-		argv_curr.append(argv_init);
-		if (!argv_curr.allocated()) {
-			err = errno;
-			if (!err) err = ENOMEM;
+	if (opt.Plan) {
+		if (batch_spawn(1, &err))
 			goto _run_out;
-		}
+		plan_summary();
+		exit(err);
 	}
 
-	close(fd); fd = -1;
-
-	delete_script();
-
 	memset(&child_info, 0, sizeof(child_info));
-	waitid(P_ALL, 0, &child_info, WEXITED);
+	if (0 == waitid(P_ALL, 0, &child_info, WEXITED))
+		USDT_PROBE3(xvp, reap, child_info.si_pid, child_info.si_code, child_info.si_status);
 	usleep(1);
 
+	if (opt._Fork_last) {
+		if (batch_spawn(1, &err))
+			goto _run_out;
+		exit(err);
+	}
+
 	do_exec();
 	exit(err);
 
@@ -632,3 +2056,18 @@ static void dump_path_error(int error_num, const char * where, const char * name
 {
 	log_stderr_path_error_ex("xvp:", name, error_num, "%s", where);
 }
+
+static int parse_uint(const char * arg, unsigned long * value)
+{
+	if ((!arg) || (!*arg)) return 0;
+
+	char * end = nullptr;
+	errno = 0;
+	unsigned long x = strtoul(arg, &end, 10);
+	if (errno || (!end) || *end) return 0;
+	// strtoul() silently negates "-<number>"
+	if (strchr(arg, '-')) return 0;
+
+	*value = x;
+	return 1;
+}
\ No newline at end of file